@@ -30,11 +30,34 @@ $(BUILD_DIR)/%.o: $(BSP_DIR)/%.c
 	@printf "| %-60s|\n" " $(subst $(BSP_DIR),bsp,./$^)"
 	@$(CC) $(CC_FLAGS) $^ -o $@
 
+UNWIND_INDEX_SRC = $(BUILD_DIR)/unwind_index.c
+UNWIND_INDEX_OBJ = $(BUILD_DIR)/unwind_index.o
+UNWIND_CALLS_SRC = $(BUILD_DIR)/unwind_calls.c
+UNWIND_CALLS_OBJ = $(BUILD_DIR)/unwind_calls.o
+
+# Tables generated by unwindgen from a first link of the target
+UNWIND_TABLES_OBJS  = $(if $(filter pages eytzinger pool,$(UNWIND_INDEX)),$(UNWIND_INDEX_OBJ))
+UNWIND_TABLES_OBJS += $(if $(filter 1,$(UNWIND_CALLS)),$(UNWIND_CALLS_OBJ))
+
 $(TARGET): print $(OBJS)
 	@mkdir -p $(@D)
 	@echo "[ =========================================================== ]"
 	@echo "|                     Linking objects ...                     |"
 	@$(CC) ${OBJS} $(LD_FLAGS) -o $@
+ifneq ($(strip $(UNWIND_TABLES_OBJS)),)
+	@echo "|                  Linking unwind tables ...                  |"
+	@$(MAKE) --no-print-directory $(HOST_BUILD_DIR)/unwindgen
+ifneq ($(filter pages eytzinger pool,$(UNWIND_INDEX)),)
+	@$(HOST_BUILD_DIR)/unwindgen $@ $(UNWIND_INDEX_SRC) $(UNWIND_INDEX) $(if $(filter pages,$(UNWIND_INDEX)),$(UNWIND_INDEX_SHIFT))
+	@$(CC) $(CC_FLAGS) $(UNWIND_INDEX_SRC) -o $(UNWIND_INDEX_OBJ)
+endif
+ifeq ($(UNWIND_CALLS),1)
+	@$(HOST_BUILD_DIR)/unwindgen $@ $(UNWIND_CALLS_SRC) calls
+	@$(CC) $(CC_FLAGS) $(UNWIND_CALLS_SRC) -o $(UNWIND_CALLS_OBJ)
+endif
+	@$(CC) ${OBJS} $(UNWIND_TABLES_OBJS) $(LD_FLAGS) -o $@
+	@$(HOST_BUILD_DIR)/unwindgen $@ --verify
+endif
 
 
 build: $(TARGET)
@@ -10,6 +10,7 @@ SRC_DIR		 = $(WORKSPACE)/src
 BUILD_DIR	 = $(WORKSPACE)/build
 BSPs_DIR	 = $(WORKSPACE)/tools/bsp
 SCRIPT_DIR	 = $(WORKSPACE)/script
+HOST_DIR	 = $(WORKSPACE)/tools/host
 ######################################
 
 
@@ -21,6 +22,8 @@ READELF 	 = arm-none-eabi-readelf
 STRIP   	 = arm-none-eabi-strip
 GDB     	 = arm-none-eabi-gdb
 EMU			 = qemu-system-arm
+HOST_CC		 = gcc
+FUZZ_CC		 = clang
 ######################################
 
 
@@ -50,13 +53,41 @@ TARGET 		 = $(BUILD_DIR)/target/$(PROJ_NAME)-$(PROJ_VERSION).elf
 CC_FLAGS  	 = -c -mcpu=$(MACH) -std=gnu11 -Werror -Wall -Wextra -pedantic -mthumb
 CC_FLAGS 	+= -D$(BOARD) -D$(CHIP)
 CC_FLAGS 	+= -g3 -DDEBUG -O0
-CC_FLAGS	+= -I$(SRC_DIR)
+CC_FLAGS	+= -I$(SRC_DIR) -I$(BSP_DIR)
+# FDIR options (e.g. FDIR_FLAGS="-DOUTPUT_SEMIHOSTING")
+FDIR_FLAGS	?=
+CC_FLAGS	+= $(FDIR_FLAGS)
 # Unwind specific
 CC_FLAGS	+= -funwind-tables
 CC_FLAGS 	+= -fexceptions
 #CC_FLAGS 	+= -fno-omit-frame-pointer
 
-LD_FLAGS     = -mcpu=$(MACH) -T $(LINKER) -static -Wall -Wextra -pedantic -mthumb
+# Unwind tables memory (itcm or dtcm), the linker script includes $(BSP_DIR)/unwind/<region>/unwind_region.ld
+UNWIND_REGION ?= itcm
+
+LD_FLAGS     = -mcpu=$(MACH) -L $(BSP_DIR)/unwind/$(UNWIND_REGION) -T $(LINKER) -static -Wall -Wextra -pedantic -mthumb
 LD_FLAGS	+= --specs=nosys.specs
 LD_FLAGS 	+= -D$(BOARD) -D$(CHIP)
+# Index of the unwind table, linked in a second pass (none, pages, eytzinger or pool, e.g. UNWIND_INDEX=pages UNWIND_INDEX_SHIFT=10)
+UNWIND_INDEX ?= none
+UNWIND_INDEX_SHIFT ?= 12
+# The pool only keeps the start of ranges of functions, their exact start is resolved on host
+CC_FLAGS	+= $(if $(filter pool,$(UNWIND_INDEX)),-DCALL_STACK_RESOLVE_FN=0)
+# Call sites table (return address to unwind entry), linked in the same second pass (e.g. UNWIND_CALLS=1)
+UNWIND_CALLS ?= 0
+######################################
+
+
+##########  Host compilation  ########
+HOST_BUILD_DIR = $(BUILD_DIR)/host
+
+HOST_CC_FLAGS  = -std=gnu11 -O2 -Werror -Wall -Wextra -pedantic
+HOST_CC_FLAGS += -I$(SRC_DIR) -I$(HOST_DIR)
+HOST_CC_FLAGS += -DSTACKTRACE_HOST
+
+# libFuzzer harness of the unwinder (make fuzz), run for FUZZ_TIME seconds
+FUZZ_CC_FLAGS  = -std=gnu11 -g -O1 -fsanitize=fuzzer,address,undefined -fno-sanitize-recover=undefined
+FUZZ_CC_FLAGS += -I$(SRC_DIR) -I$(HOST_DIR)
+FUZZ_CC_FLAGS += -DSTACKTRACE_HOST -DIMAGE_TRAP_UNMAPPED=1
+FUZZ_TIME ?= 60
 ######################################
@@ -15,7 +15,13 @@ size:
 ######################################
 
 ###############  Debug  ##############
-.PHONY += gdb debug
+.PHONY += gdb debug run scenarios placements
+
+# Fault scenarios of main.c run by `make scenarios`
+SCENARIOS	?= 0 1 2 3 4
+
+# Unwind tables placements compared by `make placements`
+UNWIND_REGIONS	?= itcm dtcm
 
 gdb: clean build readelf
 	@echo "[ =========================================================== ]"
@@ -31,4 +37,35 @@ gdb: clean build readelf
 
 debug:
 	@$(EMU) -S -s -machine mps2-an500 -cpu cortex-m7 -m 16M -kernel $(TARGET) -nographic -serial mon:stdio
+
+run:
+	@$(EMU) -machine mps2-an500 -cpu cortex-m7 -m 16M -kernel $(TARGET) -nographic -serial mon:stdio
+
+# Builds and runs each scenario with semihosting, then unwinds its dump offline
+scenarios: host
+	@echo "[ =========================================================== ]"
+	@echo "|                    Running scenarios ...                    |"
+	@for scenario in $(SCENARIOS); do \
+		dir=$(abspath $(BUILD_DIR))/scenario-$$scenario; \
+		elf=$$dir/target/$(PROJ_NAME)-$(PROJ_VERSION).elf; \
+		$(MAKE) --no-print-directory BUILD_DIR=$$dir \
+			FDIR_FLAGS="$(FDIR_FLAGS) -DOUTPUT_SEMIHOSTING -DFDIR_STACK_GUARDS=1 -DFAULT_SCENARIO=$$scenario" build > /dev/null || exit 1; \
+		start=$$(date +%s%N); \
+		(cd $$dir && timeout 10 $(EMU) -machine mps2-an500 -cpu cortex-m7 -m 16M -kernel $$elf \
+			-nographic -serial mon:stdio -semihosting-config enable=on,target=native > $$dir/uart.log); \
+		end=$$(date +%s%N); \
+		echo "| ----------------------------------------------------------- |"; \
+		printf "| %-60s|\n" "Scenario $$scenario : $$(( (end - start) / 1000000 )) ms"; \
+		$(HOST_BUILD_DIR)/dumpunwind $$elf $$dir/fdir_dump.bin || exit 1; \
+	done
+	@echo "[ =========================================================== ]"
+
+# Runs the scenarios for each placement of the unwind tables, dumpunwind prints the unwind cycles
+placements:
+	@for region in $(UNWIND_REGIONS); do \
+		echo "[ =========================================================== ]"; \
+		printf "| %-60s|\n" "Unwind tables in $$region"; \
+		$(MAKE) --no-print-directory BUILD_DIR=$(abspath $(BUILD_DIR))/unwind-$$region \
+			UNWIND_REGION=$$region scenarios || exit 1; \
+	done
 ######################################
@@ -12,10 +12,19 @@ help:
 	@echo "|    make help     Show this help message.                    |"
 	@echo "| ----------------------------------------------------------- |"
 	@echo "|    make build    Build the project.                         |"
+	@echo "|    make build UNWIND_INDEX=pages|eytzinger|pool Index.      |"
+	@echo "|    make build UNWIND_CALLS=1 Link the call sites table.     |"
 	@echo "|    make clean    Clean the project.                         |"
 	@echo "| ----------------------------------------------------------- |"
 	@echo "|    make gdb      Start gdb on port 1234.                    |"
 	@echo "|    make debug    Start QEMU with gdb started on port 1234.  |"
+	@echo "|    make run      Start QEMU, traces are sent to the UART.   |"
+	@echo "|    make scenarios Run fault scenarios, unwind dumps on host.|"
+	@echo "|    make placements Run scenarios with exidx in ITCM, DTCM.  |"
+	@echo "| ----------------------------------------------------------- |"
+	@echo "|    make host     Build the host tools (crashdecode, ...).   |"
+	@echo "|    make exidx-diff Compare unwind decoding with readelf -u. |"
+	@echo "|    make fuzz     Fuzz the unwinder (clang, FUZZ_TIME=60).   |"
 	@echo "[ =========================================================== ]"
 	@echo "|  Copyright (c) Theo Bessel - contact[at]theobessel.fr       |"
 	@echo "[ =========================================================== ]"
@@ -0,0 +1,65 @@
+###############  Host  ###############
+.PHONY += host exidx-diff stack-depth fuzz
+
+HOST_SRCS	 = $(SRC_DIR)/record.c $(SRC_DIR)/stacktrace.c
+HOST_SRCS	+= $(HOST_DIR)/image.c
+HOST_OBJS	 = $(subst $(SRC_DIR)/,$(HOST_BUILD_DIR)/,$(subst $(HOST_DIR)/,$(HOST_BUILD_DIR)/,$(HOST_SRCS:.c=.o)))
+
+HOST_TOOLS	 = $(HOST_BUILD_DIR)/crashdecode
+HOST_TOOLS	+= $(HOST_BUILD_DIR)/dumpunwind
+HOST_TOOLS	+= $(HOST_BUILD_DIR)/exidxdump
+HOST_TOOLS	+= $(HOST_BUILD_DIR)/stackdepth
+HOST_TOOLS	+= $(HOST_BUILD_DIR)/unwindgen
+
+.SECONDARY: $(HOST_OBJS)
+
+# Build shared sources for host
+$(HOST_BUILD_DIR)/%.o: $(SRC_DIR)/%.c
+	@mkdir -p $(@D)
+	@printf "| %-60s|\n" " host $(subst $(SRC_DIR),src,./$^)"
+	@$(HOST_CC) $(HOST_CC_FLAGS) -c $^ -o $@
+
+$(HOST_BUILD_DIR)/%.o: $(HOST_DIR)/%.c
+	@mkdir -p $(@D)
+	@printf "| %-60s|\n" " host $(subst $(HOST_DIR),tools,./$^)"
+	@$(HOST_CC) $(HOST_CC_FLAGS) -c $^ -o $@
+
+# Build host tools
+$(HOST_BUILD_DIR)/%: $(HOST_DIR)/%.c $(HOST_OBJS)
+	@mkdir -p $(@D)
+	@printf "| %-60s|\n" " host $(subst $(HOST_DIR),tools,./$<)"
+	@$(HOST_CC) $(HOST_CC_FLAGS) $^ -o $@
+
+host:
+	@echo "[ =========================================================== ]"
+	@echo "|                   Building host tools ...                   |"
+	@echo "|                                                             |"
+	@printf "| %-60s|\n" "CC : $(HOST_CC)"
+	@$(MAKE) --no-print-directory $(HOST_TOOLS)
+	@echo "[ =========================================================== ]"
+	@echo "|                   Host tools completed !                    |"
+	@echo "[ =========================================================== ]"
+
+# Compares the unwind instructions fetched by the unwinder with `readelf -u`, checks every opcode form and a synthetic call chain, then benchmarks it
+exidx-diff: host
+	@$(READELF) -u $(TARGET) | grep -E '^(0x[0-9a-f]+ |  0x)' | sed 's/ <.*//' > $(HOST_BUILD_DIR)/readelf.unwind
+	@$(HOST_BUILD_DIR)/exidxdump $(TARGET) | grep -E '^(0x[0-9a-f]+ |  0x)' | sed 's/ <.*//' > $(HOST_BUILD_DIR)/exidxdump.unwind
+	@diff -u $(HOST_BUILD_DIR)/readelf.unwind $(HOST_BUILD_DIR)/exidxdump.unwind
+	@echo "[ =========================================================== ]"
+	@echo "|              Unwind instructions match readelf !            |"
+	@echo "[ =========================================================== ]"
+	@$(HOST_BUILD_DIR)/exidxdump --opcodes
+	@$(HOST_BUILD_DIR)/exidxdump --chain
+	@$(HOST_BUILD_DIR)/exidxdump $(TARGET) --bench 10000
+
+# Fuzzes the unwinder with libFuzzer on split exidx / extab / index / calls / stack inputs, the corpus is kept between runs
+fuzz:
+	@mkdir -p $(HOST_BUILD_DIR)/fuzz/corpus
+	@printf "| %-60s|\n" " fuzz tools/fuzzunwind.c ($(FUZZ_CC))"
+	@$(FUZZ_CC) $(FUZZ_CC_FLAGS) $(HOST_DIR)/fuzzunwind.c $(HOST_SRCS) -o $(HOST_BUILD_DIR)/fuzz/fuzzunwind
+	@$(HOST_BUILD_DIR)/fuzz/fuzzunwind -max_total_time=$(FUZZ_TIME) $(HOST_BUILD_DIR)/fuzz/corpus
+
+# Reports the worst-case stack depth of each handler of the vector table, from the unwind tables
+stack-depth: host
+	@$(HOST_BUILD_DIR)/stackdepth $(TARGET)
+######################################
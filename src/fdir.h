@@ -15,10 +15,54 @@
 
 /***************************** Macros Definitions ****************************/
 
+// EXC_RETURN fields
+#define EXC_RETURN_SPSEL_Msk (1 << 2)   /**< Set if the frame was stacked on PSP.          */
+#define EXC_RETURN_FTYPE_Msk (1 << 4)   /**< Clear if the frame is an extended FPU frame.  */
+
+// Exception frames layout (ARMv7-M, B1.5.7)
+#define EXC_FRAME_BASIC_SIZE    0x20    /**< r0-r3, r12, lr, pc, xPSR.                     */
+#define EXC_FRAME_EXTENDED_SIZE 0x68    /**< Basic frame + S0-S15, FPSCR and a reserved word. */
+#define EXC_FRAME_LR_OFFSET     20      /**< Same offset in both basic and extended frames. */
+#define EXC_FRAME_PC_OFFSET     24      /**< Same offset in both basic and extended frames. */
+#define EXC_FRAME_XPSR_ALIGN_Msk (1 << 9) /**< Set if a word was skipped to align the frame. */
+
+// Crash ring capacity, must be a power of two
+#define CRASH_RING_SIZE 4u
+
+/**
+ * When set to 1, InitFDIR programs a no-access MPU region at the bottom of the main stack, and
+ * AddStackGuard can guard the task stacks : an overflow traps as a MemManage fault at the
+ * faulting instruction. Privileged code is assumed (PRIVDEFENA keeps the default memory map).
+ */
+#ifndef FDIR_STACK_GUARDS
+#define FDIR_STACK_GUARDS 0
+#endif
+
+// Stack guards
+#define STACK_GUARD_MAX         8u      /**< Capacity of the guard registry.               */
+#define STACK_GUARD_SIZE        32u     /**< Smallest MPU region, aligned on its size.     */
+#define STACK_GUARD_NONE        0xffffffffu /**< No guard registered or hit.               */
+
+/**
+ * @brief Tells whether an exception frame holds the FPU context, given its EXC_RETURN value
+ */
+#define EXC_FRAME_HAS_FPU(exc_return) (((exc_return) & EXC_RETURN_FTYPE_Msk) == 0)
+
+/**
+ * @brief Stack pointer of the interrupted context : the exception frame is stacked below it,
+ * one word lower when the processor had to realign the frame on 8 bytes (xPSR[9])
+ */
+#define EXC_FRAME_SP(frame, exc_return, xpsr) ( \
+    (frame) \
+    + (EXC_FRAME_HAS_FPU(exc_return) ? EXC_FRAME_EXTENDED_SIZE : EXC_FRAME_BASIC_SIZE) \
+    + (((xpsr) & EXC_FRAME_XPSR_ALIGN_Msk) ? 4 : 0) \
+)
+
 /***************************** Types Definitions *****************************/
 
 /**
  * @brief Structure to store saved CPU registers during an error.
+ * @note Packed, it has the exact layout of the exception frame pushed by the processor.
  */
 typedef struct __attribute__((packed))
 {
@@ -29,22 +73,71 @@ typedef struct __attribute__((packed))
     uint32_t xpsr;                  /**< Program status register (xPSR).     */
 } savedRegisters_t;
 
+/**
+ * @brief Structure to store the registers the processor does not stack, saved at the fault entry.
+ * @note Same order as the register list of the single STM storing it : EXC_RETURN, MSP and PSP
+ * are moved to r1-r3, followed by r4-r11.
+ */
+typedef struct
+{
+    uint32_t exc_return;            /**< EXC_RETURN value of the handler.    */
+    uint32_t msp;                   /**< Main stack pointer at capture.      */
+    uint32_t psp;                   /**< Process stack pointer at capture.   */
+    uint32_t r[8];                  /**< Callee-saved registers R4-R11.      */
+} savedCoreRegisters_t;
+
+/**
+ * @brief Structure to store saved FPU registers during an error (extended frame only).
+ */
+typedef struct __attribute__((packed))
+{
+    uint32_t s[16];                 /**< FPU registers S0-S15.               */
+    uint32_t fpscr;                 /**< Floating-point status register.     */
+} savedFpuRegisters_t;
+
 /**
  * @brief General debug information captured during an error.
  */
 typedef struct
 {
-    savedRegisters_t* registers;    /**< Pointer to saved CPU registers.     */
+    uint32_t exception;             /**< Exception number (IPSR) at capture. */
+    uint32_t frame;                 /**< Address of the exception frame.     */
+    uint32_t sp;                    /**< SP of the interrupted context.      */
+    savedRegisters_t registers;     /**< Saved CPU registers.                */
+    savedCoreRegisters_t core;      /**< Registers not stacked by the CPU.   */
+    savedFpuRegisters_t fpu_registers; /**< Saved FPU registers, only valid
+                                            if EXC_FRAME_HAS_FPU(core.exc_return). */
     uint32_t cfsr;                  /**< Configurable Fault Status Register. */
     uint32_t hfsr;                  /**< Hard Fault Status Register.         */
+    uint32_t stack_guard;           /**< Guard hit, or STACK_GUARD_NONE.     */
+    uint32_t capture_cycles;        /**< Cycles of the fault entry (DWT).    */
+    uint32_t unwind_cycles;         /**< Cycles spent in UnwindStack (DWT).  */
     callStack_t call_stack;         /**< Captured call stack.                */
 } debugInfo_t;
 
+/**
+ * @brief Ring of the last captured debug informations (faults and snapshots).
+ */
+typedef struct
+{
+    uint32_t count;                             /**< Number of records pushed so far. */
+    debugInfo_t records[CRASH_RING_SIZE];       /**< Last captured records.           */
+} crashRing_t;
+
 /*************************** Variables Declarations **************************/
 
+extern crashRing_t crash_ring;
+extern stackBounds_t stack_guards[STACK_GUARD_MAX];
+extern uint32_t stack_guard_count;
+
 extern void InitFDIR(void);
-extern void SaveRegisters(debugInfo_t* debug_info);
-extern void PrepareUnwind(call_t* last_call);
+extern uint32_t AddStackGuard(stackBounds_t stack);
+extern void SaveFpuRegisters(debugInfo_t* debug_info);
+extern void HandleFault(debugInfo_t* debug_info);
+extern void PushCrashRecord(const debugInfo_t* debug_info);
+extern void CaptureSnapshot(uint32_t exc_return, uint32_t frame, const savedCoreRegisters_t* core);
+extern void GetUnwindRegisters(const debugInfo_t* debug_info, unwindRegisters_t* vrs);
+extern stackBounds_t GetStackBounds(const debugInfo_t* debug_info);
 
 /*************************** Functions Declarations **************************/
 
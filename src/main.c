@@ -9,6 +9,50 @@
 #include <stdio.h>
 #include <stdint.h>
 #include "fdir.h"
+#include "stackwatch.h"
+
+/**
+ * Fault triggered by function_c (UsageFaults, then a MemManage fault) :
+ *   0 - Division by zero
+ *   1 - Unaligned access
+ *   2 - Undefined instruction
+ *   3 - Main stack overflow, trapped by the stack guard (FDIR_STACK_GUARDS)
+ *   4 - Division by zero, after libgcc has unwound the same call chain (`_Unwind_Backtrace`)
+ */
+#ifndef FAULT_SCENARIO
+#define FAULT_SCENARIO 0
+#endif
+
+#if FAULT_SCENARIO == 4
+#include <unwind.h>
+#include "output.h"
+
+// Call stack unwound by libgcc, compared with the one of the fault by dumpunwind
+callStack_t libgcc_call_stack = {0};
+
+_Unwind_Reason_Code CollectFrame(struct _Unwind_Context* context, void* argument) {
+    callStack_t* call_stack = (callStack_t *) argument;
+
+    if (call_stack->size >= CALL_STACK_MAX_SIZE)
+    {
+        return _URC_END_OF_STACK;
+    }
+
+    // Return address of the frame (the call site for the first one), Thumb bit cleared
+    call_stack->calls[call_stack->size].pc = _Unwind_GetIP(context);
+    call_stack->calls[call_stack->size].sp = _Unwind_GetGR(context, 13);
+    call_stack->size += 1;
+
+    return _URC_NO_REASON;
+}
+#endif
+
+uint32_t __attribute__((noinline)) function_d(uint32_t d) {
+    // Unbounded recursion, each frame holds a small local array
+    volatile uint32_t frame[8] = { d };
+
+    return function_d(frame[0] + 1) + frame[0];
+}
 
 void __attribute__((noinline)) function_c(uint32_t c) {
     // Random operation to have frames with registers pushed on the stack
@@ -18,8 +62,25 @@ void __attribute__((noinline)) function_c(uint32_t c) {
     printf("%d", (int) a);
     printf("%d", (int) b);
 
+#if FAULT_SCENARIO == 1
+    // Causes UsageFault (unaligned access)
+    volatile uint32_t result = *((volatile uint32_t *) ((uint32_t) &a + 1));
+#elif FAULT_SCENARIO == 2
+    // Causes UsageFault (undefined instruction)
+    __asm volatile ("udf #0");
+    volatile uint32_t result = a;
+#elif FAULT_SCENARIO == 3
+    // Causes MemManage fault (stack overflow)
+    volatile uint32_t result = function_d(a);
+#elif FAULT_SCENARIO == 4
+    // Unwinds the call chain with libgcc, then causes UsageFault
+    _Unwind_Backtrace(CollectFrame, &libgcc_call_stack);
+    SetDumpReference(&libgcc_call_stack);
+    volatile uint32_t result = a / b;
+#else
     // Causes UsageFault
     volatile uint32_t result = a / b;
+#endif
 
     (void) result;
 }
@@ -51,6 +112,10 @@ int main(void) {
     // Causes UsageFault (division by zero)
     function_a(13);
 
-    while (1);
+    // Idle loop
+    while (1)
+    {
+        PollStackWatch();
+    }
     return 0;
 }
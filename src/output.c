@@ -0,0 +1,441 @@
+/**
+ * @file    output.c
+ * @author  Théo Bessel
+ * @brief   Interface for stack trace output channels
+ *
+ * Traces are written to a software queue and sent to the UART by OutputPoll, which only
+ * writes as many bytes as the transmitter accepts. Nothing ever waits for the UART, so
+ * the fault handler is never blocked by the output. The queue is filled from the idle loop
+ * (stack usage) and from handlers (faults, snapshots) that may preempt it : each write and
+ * each sent byte updates the queue with interrupts masked (PRIMASK), and the stack usage
+ * line is queued as a whole, so a trace never lands in the middle of it.
+ *
+ * Text format, one line per frame as soon as it is unwound :
+ *   *** exception 6 pc 0x000001d0 sp 0x20007fd8 cfsr 0x02000000 hfsr 0x00000000
+ *   #0 0x000001b4
+ *   ...
+ *   *** 812 cycles (entry 44)
+ *
+ * The header ends with ` guard N` when the fault hit the MPU guard N of a stack.
+ *
+ * The stack monitor (stackwatch.c) adds a line each time a stack is found deeper :
+ *   *** stack 0 peak 312 / 1024
+ * In binary format, it is a stack usage record of record.c instead.
+ *
+ * Binary format : the compact record of record.c, once the unwind is done.
+ *
+ * With OUTPUT_SEMIHOSTING, OutputDump also writes the whole debugInfo_t and a window of
+ * the faulting stack to a host file through ARM semihosting, then stops the simulation so
+ * that fault scenarios can run unattended (QEMU `-semihosting`). A call stack unwound by
+ * another unwinder (see SetDumpReference) follows the stack window, so that the host can
+ * compare it with the one of the record. Without a debugger or
+ * QEMU semihosting, the `bkpt` used by semihosting faults : keep it disabled on target.
+ *
+ * @copyright Copyright (c) Théo Bessel 2024
+ */
+
+/******************************* Include Files *******************************/
+
+#include "output.h"
+#include "record.h"
+#include "MPS2_AN500_uart.h"
+
+/***************************** Macros Definitions ****************************/
+
+// Semihosting operations
+#define SYS_OPEN    0x01
+#define SYS_CLOSE   0x02
+#define SYS_WRITE   0x05
+#define SYS_CLOCK   0x10
+#define SYS_EXIT    0x18
+
+#define SYS_OPEN_MODE_WB                0x5
+#define ADP_STOPPED_APPLICATION_EXIT    0x20026
+
+/*************************** Functions Declarations **************************/
+
+void InitOutput(void);
+void OutputTraceBegin(const debugInfo_t* debug_info);
+void OutputTraceEnd(const debugInfo_t* debug_info);
+void OutputPoll(void);
+void OutputDump(const debugInfo_t* debug_info);
+void SetDumpReference(const callStack_t* call_stack);
+void OutputStackUsage(uint32_t index, uint32_t peak, uint32_t size);
+
+uint32_t SemihostingCall(uint32_t operation, const void* args);
+void OutputWrite(const uint8_t* buffer, uint32_t size);
+void OutputString(const char* string);
+void OutputHex(uint32_t value);
+void OutputDecimal(uint32_t value);
+void OutputFrame(uint32_t index, const call_t* call);
+uint32_t LockOutput(void);
+void UnlockOutput(uint32_t primask);
+
+/*************************** Variables Definitions ***************************/
+
+/**
+ * @brief UART transmit queue
+ */
+outputQueue_t output_queue = {0};
+
+/**
+ * @brief Call stack written after the stack window of the semihosting dump
+ */
+static const callStack_t* dump_reference = 0;
+
+/**
+ * @brief End of the main stack (linker script)
+ */
+extern uint32_t __stack_end__;
+
+/*************************** Functions Definitions ***************************/
+
+/**
+ * @brief This function initialises the output channel
+ * @return Nothing
+ */
+void InitOutput(void)
+{
+    UART_Init();
+
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_TEXT
+    // Frames are streamed while they are unwound
+    SetFrameHook(OutputFrame);
+#endif
+}
+
+/**
+ * @brief This function starts the output of a trace
+ * @param[in] debug_info          The debugging informations being captured
+ * @return Nothing
+ */
+void OutputTraceBegin(const debugInfo_t* debug_info)
+{
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_TEXT
+    OutputString("*** exception ");
+    OutputDecimal(debug_info->exception);
+    OutputString(" pc ");
+    OutputHex(debug_info->registers.pc);
+    OutputString(" sp ");
+    OutputHex(debug_info->sp);
+    OutputString(" cfsr ");
+    OutputHex(debug_info->cfsr);
+    OutputString(" hfsr ");
+    OutputHex(debug_info->hfsr);
+    if (debug_info->stack_guard != STACK_GUARD_NONE)
+    {
+        OutputString(" guard ");
+        OutputDecimal(debug_info->stack_guard);
+    }
+    OutputString("\n");
+#else
+    (void) debug_info;
+#endif
+
+    OutputPoll();
+}
+
+/**
+ * @brief This function ends the output of a trace
+ * @param[in] debug_info          The captured debugging informations
+ * @return Nothing
+ */
+void OutputTraceEnd(const debugInfo_t* debug_info)
+{
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_TEXT
+    OutputString("*** ");
+    OutputDecimal(debug_info->unwind_cycles);
+    OutputString(" cycles (entry ");
+    OutputDecimal(debug_info->capture_cycles);
+    OutputString(")\n");
+#else
+    uint8_t record[RECORD_MAX_SIZE];
+
+    OutputWrite(record, EncodeCrashRecord(debug_info, record, sizeof(record)));
+#endif
+
+    OutputPoll();
+}
+
+/**
+ * @brief This function sends queued bytes to the UART until its transmitter is full
+ * @note Must be called periodically (idle loop, fault handler loop) to drain the queue.
+ * @return Nothing
+ */
+void OutputPoll(void)
+{
+    uint32_t primask = LockOutput();
+
+    while (output_queue.tail != output_queue.head)
+    {
+        if (!UART_TryPutc(output_queue.data[output_queue.tail & (OUTPUT_QUEUE_SIZE - 1)]))
+        {
+            break;
+        }
+        output_queue.tail += 1;
+
+        // Lets a pending handler preempt the drain between two bytes
+        UnlockOutput(primask);
+        primask = LockOutput();
+    }
+
+    UnlockOutput(primask);
+}
+
+/**
+ * @brief This function outputs the peak usage of a watched stack
+ * @param[in] index               The index of the watched stack (0 for the main stack)
+ * @param[in] peak                The high-water mark, in bytes from the top of the stack
+ * @param[in] size                The size of the watched part of the stack
+ * @return Nothing
+ */
+void OutputStackUsage(uint32_t index, uint32_t peak, uint32_t size)
+{
+#if OUTPUT_FORMAT == OUTPUT_FORMAT_TEXT
+    uint32_t primask = LockOutput();
+
+    OutputString("*** stack ");
+    OutputDecimal(index);
+    OutputString(" peak ");
+    OutputDecimal(peak);
+    OutputString(" / ");
+    OutputDecimal(size);
+    OutputString("\n");
+
+    UnlockOutput(primask);
+#else
+    uint8_t record[RECORD_STACK_USAGE_MAX_SIZE];
+
+    OutputWrite(record, EncodeStackUsageRecord(index, peak, size, record, sizeof(record)));
+#endif
+
+    OutputPoll();
+}
+
+/**
+ * @brief This function writes the debugging informations and a window of the faulting
+ * stack to OUTPUT_DUMP_FILE on the host, then exits the simulation.
+ * @note Does nothing unless OUTPUT_SEMIHOSTING is defined.
+ * @param[in] debug_info          The captured debugging informations
+ * @return Nothing
+ */
+void OutputDump(const debugInfo_t* debug_info)
+{
+#ifdef OUTPUT_SEMIHOSTING
+    uint32_t stack_end = (uint32_t) &__stack_end__;
+    dumpHeader_t header = {
+        .magic = OUTPUT_DUMP_MAGIC,
+        .version = OUTPUT_DUMP_VERSION,
+        .info_size = sizeof(debugInfo_t),
+        .call_size = sizeof(call_t),
+        .clock = SemihostingCall(SYS_CLOCK, 0),
+        .stack_start = debug_info->frame,
+        .stack_size = OUTPUT_DUMP_STACK_SIZE,
+        .reference_size = dump_reference ? sizeof(callStack_t) : 0,
+    };
+    uint32_t open_args[3] = { (uint32_t) OUTPUT_DUMP_FILE, SYS_OPEN_MODE_WB, sizeof(OUTPUT_DUMP_FILE) - 1 };
+    uint32_t write_args[3] = {0};
+    uint32_t handle = 0;
+
+    // Do not read past the end of the main stack
+    if (header.stack_start < stack_end && header.stack_start + header.stack_size > stack_end)
+    {
+        header.stack_size = stack_end - header.stack_start;
+    }
+
+    handle = SemihostingCall(SYS_OPEN, open_args);
+
+    if (handle != 0xffffffff)
+    {
+        write_args[0] = handle;
+
+        write_args[1] = (uint32_t) &header;
+        write_args[2] = sizeof(header);
+        SemihostingCall(SYS_WRITE, write_args);
+
+        write_args[1] = (uint32_t) debug_info;
+        write_args[2] = sizeof(debugInfo_t);
+        SemihostingCall(SYS_WRITE, write_args);
+
+        write_args[1] = header.stack_start;
+        write_args[2] = header.stack_size;
+        SemihostingCall(SYS_WRITE, write_args);
+
+        if (dump_reference)
+        {
+            write_args[1] = (uint32_t) dump_reference;
+            write_args[2] = sizeof(callStack_t);
+            SemihostingCall(SYS_WRITE, write_args);
+        }
+
+        SemihostingCall(SYS_CLOSE, &handle);
+    }
+
+    SemihostingCall(SYS_EXIT, (const void *) ADP_STOPPED_APPLICATION_EXIT);
+#else
+    (void) debug_info;
+#endif
+}
+
+/**
+ * @brief This function sets the call stack written after the stack window by OutputDump
+ * @note The call stack must still be valid when the fault is dumped.
+ * @param[in] call_stack          The reference call stack, or 0 for none
+ * @return Nothing
+ */
+void SetDumpReference(const callStack_t* call_stack)
+{
+    dump_reference = call_stack;
+}
+
+/**
+ * @brief This function performs an ARM semihosting call
+ * @param[in] operation           The semihosting operation number
+ * @param[in] args                The parameter block (or value) of the operation
+ * @return The value returned by the host in r0
+ */
+uint32_t SemihostingCall(uint32_t operation, const void* args)
+{
+    register uint32_t r0 __asm("r0") = operation;
+    register const void* r1 __asm("r1") = args;
+
+    __asm volatile (
+        "bkpt 0xab          \n"    // Semihosting trap (Thumb)
+        : "+r" (r0)                 // Output operands
+        : "r" (r1)                  // Input operands
+        : "memory"                  // Clobbered register
+    );
+
+    return r0;
+}
+
+/**
+ * @brief This function queues bytes, bytes that do not fit are dropped
+ * @param[in] buffer              The bytes to send
+ * @param[in] size                The number of bytes to send
+ * @return Nothing
+ */
+void OutputWrite(const uint8_t* buffer, uint32_t size)
+{
+    uint32_t primask = LockOutput();
+
+    for (uint32_t index = 0; index < size; index++)
+    {
+        if (output_queue.head - output_queue.tail >= OUTPUT_QUEUE_SIZE)
+        {
+            output_queue.dropped += size - index;
+            break;
+        }
+
+        output_queue.data[output_queue.head & (OUTPUT_QUEUE_SIZE - 1)] = buffer[index];
+        output_queue.head += 1;
+    }
+
+    UnlockOutput(primask);
+}
+
+/**
+ * @brief This function masks the interrupts with a configurable priority (PRIMASK) while
+ * the queue is updated
+ * @note Hard faults are not masked, the code run while locked must not fault.
+ * @return The previous PRIMASK, to give back to UnlockOutput
+ */
+uint32_t LockOutput(void)
+{
+    uint32_t primask = 0;
+
+    __asm volatile (
+        "mrs %[primask], primask    \n"
+        "cpsid i                    \n"
+        : [primask] "=r" (primask)  // Output operands
+        :                           // No input operands
+        : "memory"                  // Clobbered memory
+    );
+
+    return primask;
+}
+
+/**
+ * @brief This function restores the PRIMASK saved by LockOutput, so that nested locks do
+ * not unmask the interrupts early
+ * @param[in] primask             The PRIMASK returned by LockOutput
+ * @return Nothing
+ */
+void UnlockOutput(uint32_t primask)
+{
+    __asm volatile ("msr primask, %[primask]" : : [primask] "r" (primask) : "memory");
+}
+
+/**
+ * @brief This function queues a null-terminated string
+ * @param[in] string              The string to send
+ * @return Nothing
+ */
+void OutputString(const char* string)
+{
+    uint32_t size = 0;
+
+    while (string[size] != '\0')
+    {
+        size++;
+    }
+
+    OutputWrite((const uint8_t *) string, size);
+}
+
+/**
+ * @brief This function queues a 32-bit value as `0x%08x`
+ * @param[in] value               The value to send
+ * @return Nothing
+ */
+void OutputHex(uint32_t value)
+{
+    uint8_t text[10] = { '0', 'x' };
+
+    for (uint32_t index = 0; index < 8; index++)
+    {
+        text[9 - index] = "0123456789abcdef"[value & 0xf];
+        value >>= 4;
+    }
+
+    OutputWrite(text, sizeof(text));
+}
+
+/**
+ * @brief This function queues a 32-bit value in decimal
+ * @param[in] value               The value to send
+ * @return Nothing
+ */
+void OutputDecimal(uint32_t value)
+{
+    uint8_t text[10];
+    uint32_t index = sizeof(text);
+
+    do {
+        text[--index] = '0' + value % 10;
+        value /= 10;
+    } while (value != 0);
+
+    OutputWrite(text + index, sizeof(text) - index);
+}
+
+/**
+ * @brief This function queues a frame as soon as it has been unwound, and tries to send it
+ * @param[in] index               The index of the frame in the call stack
+ * @param[in] call                The unwound frame
+ * @return Nothing
+ */
+void OutputFrame(uint32_t index, const call_t* call)
+{
+    OutputString("#");
+    OutputDecimal(index);
+    OutputString(" ");
+    OutputHex(call->pc);
+#if CALL_STACK_RESOLVE_FN
+    OutputString(" in ");
+    OutputHex(call->fn);
+#endif
+    OutputString("\n");
+
+    OutputPoll();
+}
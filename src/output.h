@@ -0,0 +1,74 @@
+/**
+ * @file    output.h
+ * @author  Théo Bessel
+ * @brief   Interface for stack trace output channels
+ *
+ * @copyright Copyright (c) Théo Bessel 2024
+ */
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+/******************************* Include Files *******************************/
+
+#include "fdir.h"
+
+/***************************** Macros Definitions ****************************/
+
+// Output formats
+#define OUTPUT_FORMAT_TEXT      0x0
+#define OUTPUT_FORMAT_BINARY    0x1
+
+#ifndef OUTPUT_FORMAT
+#define OUTPUT_FORMAT OUTPUT_FORMAT_TEXT
+#endif
+
+// UART transmit queue capacity, must be a power of two
+#define OUTPUT_QUEUE_SIZE 512u
+
+// Semihosting dump (enabled with OUTPUT_SEMIHOSTING)
+#define OUTPUT_DUMP_MAGIC       0x52494446  /**< "FDIR" */
+#define OUTPUT_DUMP_VERSION     0x7u
+#define OUTPUT_DUMP_FILE        "fdir_dump.bin"
+#define OUTPUT_DUMP_STACK_SIZE  0x400u
+
+/***************************** Types Definitions *****************************/
+
+/**
+ * @brief Software transmit queue, drained by OutputPoll.
+ */
+typedef struct
+{
+    uint32_t head;                          /**< Next byte to write.             */
+    uint32_t tail;                          /**< Next byte to send.              */
+    uint32_t dropped;                       /**< Bytes dropped on a full queue.  */
+    uint8_t data[OUTPUT_QUEUE_SIZE];        /**< Queued bytes.                   */
+} outputQueue_t;
+
+/**
+ * @brief Header of a semihosting dump, followed by the debugInfo_t, the stack window and the
+ * reference call stack (see SetDumpReference).
+ */
+typedef struct
+{
+    uint32_t magic;                         /**< OUTPUT_DUMP_MAGIC.              */
+    uint32_t version;                       /**< OUTPUT_DUMP_VERSION.            */
+    uint32_t info_size;                     /**< Size of debugInfo_t.            */
+    uint32_t call_size;                     /**< Size of call_t.                 */
+    uint32_t clock;                         /**< Time of the dump (centiseconds).*/
+    uint32_t stack_start;                   /**< Address of the stack window.    */
+    uint32_t stack_size;                    /**< Size of the stack window.       */
+    uint32_t reference_size;                /**< Size of the reference, or 0.    */
+} dumpHeader_t;
+
+/*************************** Functions Declarations **************************/
+
+extern void InitOutput(void);
+extern void OutputTraceBegin(const debugInfo_t* debug_info);
+extern void OutputTraceEnd(const debugInfo_t* debug_info);
+extern void OutputPoll(void);
+extern void OutputDump(const debugInfo_t* debug_info);
+extern void SetDumpReference(const callStack_t* call_stack);
+extern void OutputStackUsage(uint32_t index, uint32_t peak, uint32_t size);
+
+#endif /* OUTPUT_H */
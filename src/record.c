@@ -0,0 +1,320 @@
+/**
+ * @file    record.c
+ * @author  Théo Bessel
+ * @brief   Interface for compact crash records serialization
+ *
+ * Record layout (version 3), every field but the first and last ones being ULEB128 :
+ *   | version (1 byte) | exception | ~exc_return | r0 | r1 | r2 | r3 | r12 | lr | pc |
+ *   | rotl(xpsr, 8) | cfsr | hfsr | guard | frame count | frames... | CRC-16 (2 bytes, LE) |
+ *
+ * The guard field is the MPU stack guard hit by the fault plus one, 0 when none was hit
+ * (STACK_GUARD_NONE).
+ *
+ * The stack monitor (stackwatch.c) interleaves stack usage records in the same stream :
+ *   | RECORD_STACK_USAGE (1 byte) | stack index | peak | size | CRC-16 (2 bytes, LE) |
+ *
+ * Code addresses (lr, pc, frames) are relative to RECORD_CODE_BASE, and each frame is the
+ * zigzag-encoded difference with the previous one (the pc for the first one, which usually
+ * is the same address), so a 10 frames record usually fits in less than 64 bytes. Frames
+ * only hold their pc, function starts are resolved on host. This file does not depend on
+ * the target, it is also built on host.
+ *
+ * @copyright Copyright (c) Théo Bessel 2024
+ */
+
+/******************************* Include Files *******************************/
+
+#include "record.h"
+
+/***************************** Macros Definitions ****************************/
+
+// CRC-16/CCITT-FALSE
+#define CRC16_INIT 0xffff
+
+// Bit manipulation
+#define ROTL(word, n) (((word) << (n)) | ((word) >> (32 - (n))))
+#define ZIGZAG(delta) ((uint32_t) (((delta) << 1) ^ ((int32_t) (delta) >> 31)))
+#define UNZIGZAG(word) ((uint32_t) ((word) >> 1) ^ (uint32_t) -((int32_t) ((word) & 0x1)))
+
+/*************************** Functions Declarations **************************/
+
+uint32_t EncodeCrashRecord(const debugInfo_t* debug_info, uint8_t* buffer, uint32_t size);
+uint32_t DecodeCrashRecord(const uint8_t* buffer, uint32_t size, debugInfo_t* debug_info);
+uint32_t EncodeStackUsageRecord(uint32_t index, uint32_t peak, uint32_t stack_size, uint8_t* buffer, uint32_t size);
+uint32_t DecodeStackUsageRecord(const uint8_t* buffer, uint32_t size, uint32_t* index, uint32_t* peak, uint32_t* stack_size);
+
+uint32_t PutUleb128(uint8_t* buffer, uint32_t value);
+uint32_t GetUleb128(const uint8_t* buffer, const uint8_t* const end, uint32_t* value);
+uint16_t __attribute__((pure)) Crc16(const uint8_t* buffer, uint32_t size);
+
+/*************************** Variables Definitions ***************************/
+
+/**
+ * @brief CRC-16/CCITT-FALSE table, one entry per nibble
+ */
+static const uint16_t crc16_table[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+    0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+};
+
+/*************************** Functions Definitions ***************************/
+
+/**
+ * @brief This function serializes debugging informations into a compact record.
+ * @param[in] debug_info          The debugging informations to serialize
+ * @param[out] buffer             The buffer where to write the record
+ * @param[in] size                The size of the buffer, at least RECORD_MAX_SIZE
+ * @return The size of the record, or 0 if the buffer is too small
+ */
+uint32_t EncodeCrashRecord(const debugInfo_t* debug_info, uint8_t* buffer, uint32_t size)
+{
+    uint32_t length = 0;
+    uint32_t previous = debug_info->registers.pc;
+    uint32_t frame_count = debug_info->call_stack.size;
+    uint16_t crc = 0;
+
+    if (size < RECORD_MAX_SIZE)
+    {
+        return 0;
+    }
+
+    if (frame_count > CALL_STACK_MAX_SIZE)
+    {
+        frame_count = CALL_STACK_MAX_SIZE;
+    }
+
+    buffer[length++] = RECORD_VERSION;
+
+    length += PutUleb128(buffer + length, debug_info->exception);
+    length += PutUleb128(buffer + length, ~debug_info->core.exc_return);     // 0xfffffffx -> 1 byte
+    length += PutUleb128(buffer + length, debug_info->registers.r[0]);
+    length += PutUleb128(buffer + length, debug_info->registers.r[1]);
+    length += PutUleb128(buffer + length, debug_info->registers.r[2]);
+    length += PutUleb128(buffer + length, debug_info->registers.r[3]);
+    length += PutUleb128(buffer + length, debug_info->registers.r12);
+    length += PutUleb128(buffer + length, debug_info->registers.lr - RECORD_CODE_BASE);
+    length += PutUleb128(buffer + length, debug_info->registers.pc - RECORD_CODE_BASE);
+    length += PutUleb128(buffer + length, ROTL(debug_info->registers.xpsr, 8));  // Flags -> low bits
+    length += PutUleb128(buffer + length, debug_info->cfsr);
+    length += PutUleb128(buffer + length, debug_info->hfsr);
+    length += PutUleb128(buffer + length, debug_info->stack_guard + 1);        // STACK_GUARD_NONE -> 0
+    length += PutUleb128(buffer + length, frame_count);
+
+    for (uint32_t index = 0; index < frame_count; index++)
+    {
+        uint32_t address = debug_info->call_stack.calls[index].pc;
+
+        length += PutUleb128(buffer + length, ZIGZAG(address - previous));
+        previous = address;
+    }
+
+    crc = Crc16(buffer, length);
+    buffer[length++] = crc & 0xff;
+    buffer[length++] = crc >> 8;
+
+    return length;
+}
+
+/**
+ * @brief This function deserializes a compact record into debugging informations.
+ * @note Fields that are not part of the record (frame, FPU registers, stack pointers)
+ * are cleared.
+ * @param[in] buffer              The buffer holding the record
+ * @param[in] size                The number of bytes available in the buffer
+ * @param[out] debug_info         The structure where to store the debugging informations
+ * @return The size of the record, or 0 if it is truncated, corrupted or of another version
+ */
+uint32_t DecodeCrashRecord(const uint8_t* buffer, uint32_t size, debugInfo_t* debug_info)
+{
+    const uint8_t* const end = buffer + size;
+    const uint8_t* cursor = buffer + 1;
+    uint32_t previous = 0;
+    uint32_t fields[14] = {0};
+    uint32_t delta = 0;
+    uint32_t length = 0;
+
+    if (size < 3 || buffer[0] != RECORD_VERSION)
+    {
+        return 0;
+    }
+
+    for (uint32_t index = 0; index < 14; index++)
+    {
+        cursor += GetUleb128(cursor, end, &fields[index]);
+    }
+
+    // fields[13] is the frame count
+    if (fields[13] > CALL_STACK_MAX_SIZE)
+    {
+        return 0;
+    }
+
+    *debug_info = (debugInfo_t) {0};
+
+    // fields[8] is the pc, the first frame is encoded relative to it
+    previous = fields[8] + RECORD_CODE_BASE;
+
+    for (uint32_t index = 0; index < fields[13]; index++)
+    {
+        cursor += GetUleb128(cursor, end, &delta);
+        previous += UNZIGZAG(delta);
+        debug_info->call_stack.calls[index].pc = previous;
+    }
+
+    length = cursor - buffer;
+
+    // GetUleb128 never reads past `end`, but the CRC must still be there
+    if (length + 2 > size || Crc16(buffer, length) != (buffer[length] | (buffer[length + 1] << 8)))
+    {
+        return 0;
+    }
+
+    debug_info->exception        = fields[0];
+    debug_info->core.exc_return  = ~fields[1];
+    debug_info->registers.r[0]   = fields[2];
+    debug_info->registers.r[1]   = fields[3];
+    debug_info->registers.r[2]   = fields[4];
+    debug_info->registers.r[3]   = fields[5];
+    debug_info->registers.r12    = fields[6];
+    debug_info->registers.lr     = fields[7] + RECORD_CODE_BASE;
+    debug_info->registers.pc     = fields[8] + RECORD_CODE_BASE;
+    debug_info->registers.xpsr   = ROTL(fields[9], 24);
+    debug_info->cfsr             = fields[10];
+    debug_info->hfsr             = fields[11];
+    debug_info->stack_guard      = fields[12] - 1;     // 0 -> STACK_GUARD_NONE
+    debug_info->call_stack.size  = fields[13];
+
+    return length + 2;
+}
+
+/**
+ * @brief This function serializes the peak usage of a watched stack into a stack usage record.
+ * @param[in] index               The index of the watched stack
+ * @param[in] peak                The high-water mark, in bytes from the top of the stack
+ * @param[in] stack_size          The size of the watched part of the stack
+ * @param[out] buffer             The buffer where to write the record
+ * @param[in] size                The size of the buffer, at least RECORD_STACK_USAGE_MAX_SIZE
+ * @return The size of the record, or 0 if the buffer is too small
+ */
+uint32_t EncodeStackUsageRecord(uint32_t index, uint32_t peak, uint32_t stack_size, uint8_t* buffer, uint32_t size)
+{
+    uint32_t length = 0;
+    uint16_t crc = 0;
+
+    if (size < RECORD_STACK_USAGE_MAX_SIZE)
+    {
+        return 0;
+    }
+
+    buffer[length++] = RECORD_STACK_USAGE;
+
+    length += PutUleb128(buffer + length, index);
+    length += PutUleb128(buffer + length, peak);
+    length += PutUleb128(buffer + length, stack_size);
+
+    crc = Crc16(buffer, length);
+    buffer[length++] = crc & 0xff;
+    buffer[length++] = crc >> 8;
+
+    return length;
+}
+
+/**
+ * @brief This function deserializes a stack usage record.
+ * @param[in] buffer              The buffer holding the record
+ * @param[in] size                The number of bytes available in the buffer
+ * @param[out] index              The index of the watched stack
+ * @param[out] peak               The high-water mark, in bytes from the top of the stack
+ * @param[out] stack_size         The size of the watched part of the stack
+ * @return The size of the record, or 0 if it is truncated, corrupted or not a stack usage record
+ */
+uint32_t DecodeStackUsageRecord(const uint8_t* buffer, uint32_t size, uint32_t* index, uint32_t* peak, uint32_t* stack_size)
+{
+    const uint8_t* const end = buffer + size;
+    const uint8_t* cursor = buffer + 1;
+    uint32_t length = 0;
+
+    if (size < 3 || buffer[0] != RECORD_STACK_USAGE)
+    {
+        return 0;
+    }
+
+    cursor += GetUleb128(cursor, end, index);
+    cursor += GetUleb128(cursor, end, peak);
+    cursor += GetUleb128(cursor, end, stack_size);
+
+    length = cursor - buffer;
+
+    if (length + 2 > size || Crc16(buffer, length) != (buffer[length] | (buffer[length + 1] << 8)))
+    {
+        return 0;
+    }
+
+    return length + 2;
+}
+
+/**
+ * @brief This function writes a value with ULEB128 encoding.
+ * @param[out] buffer             The buffer where to write the value (at least 5 bytes)
+ * @param[in] value               The value to encode
+ * @return The number of bytes written
+ */
+uint32_t PutUleb128(uint8_t* buffer, uint32_t value)
+{
+    uint32_t length = 0;
+
+    while (value >= 0x80)
+    {
+        buffer[length++] = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }
+    buffer[length++] = value;
+
+    return length;
+}
+
+/**
+ * @brief This function reads a value with ULEB128 encoding.
+ * @param[in] buffer              The buffer holding the value
+ * @param[in] end                 The end of the buffer, never read
+ * @param[out] value              The decoded value (truncated to 32 bits)
+ * @return The number of bytes read
+ */
+uint32_t GetUleb128(const uint8_t* buffer, const uint8_t* const end, uint32_t* value)
+{
+    uint32_t length = 0;
+    uint32_t shift = 0;
+    uint32_t byte = 0x80;
+
+    *value = 0;
+
+    while ((byte & 0x80) && buffer + length < end && shift < 35)
+    {
+        byte = buffer[length++];
+        *value |= (byte & 0x7f) << shift;
+        shift += 7;
+    }
+
+    return length;
+}
+
+/**
+ * @brief This function computes the CRC-16/CCITT-FALSE of a buffer.
+ * @warning This function is annotated with the `pure` attribute for
+ * performance purpose, it must remain pure if it's changed
+ * @param[in] buffer              The buffer
+ * @param[in] size                The size of the buffer
+ * @return The CRC of the buffer
+ */
+uint16_t __attribute__((pure)) Crc16(const uint8_t* buffer, uint32_t size)
+{
+    uint16_t crc = CRC16_INIT;
+
+    for (uint32_t index = 0; index < size; index++)
+    {
+        crc = (crc << 4) ^ crc16_table[(crc >> 12) ^ (buffer[index] >> 4)];
+        crc = (crc << 4) ^ crc16_table[(crc >> 12) ^ (buffer[index] & 0xf)];
+    }
+
+    return crc;
+}
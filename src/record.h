@@ -0,0 +1,44 @@
+/**
+ * @file    record.h
+ * @author  Théo Bessel
+ * @brief   Interface for compact crash records serialization
+ *
+ * @copyright Copyright (c) Théo Bessel 2024
+ */
+
+#ifndef RECORD_H
+#define RECORD_H
+
+/******************************* Include Files *******************************/
+
+#include "fdir.h"
+
+/***************************** Macros Definitions ****************************/
+
+#define RECORD_VERSION      0x3u
+
+// First byte of a stack usage record, never a crash record version
+#define RECORD_STACK_USAGE  0x53u
+
+// Code addresses are encoded relative to the ITCM base
+#define RECORD_CODE_BASE    0x0u
+
+/**
+ * @brief Worst case size of an encoded record : version, 14 ULEB128 words, frame count,
+ * CALL_STACK_MAX_SIZE ULEB128 deltas and the CRC-16 trailer.
+ */
+#define RECORD_MAX_SIZE     (1u + 5u * 14u + 1u + 5u * CALL_STACK_MAX_SIZE + 2u)
+
+/**
+ * @brief Worst case size of a stack usage record : tag, 3 ULEB128 words and the CRC-16 trailer.
+ */
+#define RECORD_STACK_USAGE_MAX_SIZE (1u + 5u * 3u + 2u)
+
+/*************************** Functions Declarations **************************/
+
+extern uint32_t EncodeCrashRecord(const debugInfo_t* debug_info, uint8_t* buffer, uint32_t size);
+extern uint32_t DecodeCrashRecord(const uint8_t* buffer, uint32_t size, debugInfo_t* debug_info);
+extern uint32_t EncodeStackUsageRecord(uint32_t index, uint32_t peak, uint32_t stack_size, uint8_t* buffer, uint32_t size);
+extern uint32_t DecodeStackUsageRecord(const uint8_t* buffer, uint32_t size, uint32_t* index, uint32_t* peak, uint32_t* stack_size);
+
+#endif /* RECORD_H */
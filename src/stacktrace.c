@@ -8,6 +8,7 @@
 
 /******************************* Include Files *******************************/
 
+#include <stddef.h>
 #include "fdir.h"
 
 /***************************** Macros Definitions ****************************/
@@ -15,109 +16,241 @@
 // CantUnwind symbol
 #define EXIDX_CANTUNWIND 0x1
 
+// Su16 entry made of three `finish`, the unwinding instructions of a frame that pushed nothing
+#define EXIDX_NO_FRAME 0x80b0b0b0
+
 // Personality routine indexes
 #define SU16 0x0
 #define LU16 0x1
 #define LU32 0x2
 
+// Unwind end markers
+#define UNWIND_END 0xffffffff
+
 // debugInfo_t manipulation
 #define LAST_CALL(call_stack) call_stack->calls[call_stack->size]
 
+/**
+ * Frame 0 holds the interrupted instruction, the other frames hold return addresses : the
+ * call site is just before, and may be the last instruction of its function (`noreturn`).
+ */
+#define CALL_SITE(call_stack, index) ((index) == 0 ? (call_stack)->calls[index].pc : (call_stack)->calls[index].pc - 1)
+
+// Whether `words` words starting at `address` lie within `.ARM.extab`
+#define IN_EXTAB(address, words) ( \
+    (address) >= EXTAB_START \
+    && (address) < EXTAB_END \
+    && !((address) & 0x3) \
+    && (EXTAB_END - (address)) / 4 >= (words) \
+)
+
 // Masks
 #define SIX_RIGHT_MASK(instruction) ((instruction & 0x3f) << 2)
 
+// Target memory accesses, the unwinder is also built on host (STACKTRACE_HOST) by the offline tools
+#ifdef STACKTRACE_HOST
+#define READ_WORD(address) HostReadWord(address)
+#define EXIDX_START host_exidx_start
+#define EXIDX_END host_exidx_end
+#define EXTAB_START host_extab_start
+#define EXTAB_END host_extab_end
+#define UNWIND_INDEX_START host_unwind_index_start
+#define UNWIND_INDEX_END host_unwind_index_end
+#define CALL_SITES_START host_unwind_calls_start
+#define CALL_SITES_END host_unwind_calls_end
+#else
+#define READ_WORD(address) (*((uint32_t *) (address)))
+#define EXIDX_START ((uint32_t) &__exidx_start)
+#define EXIDX_END ((uint32_t) &__exidx_end)
+#define EXTAB_START ((uint32_t) &__extab_start)
+#define EXTAB_END ((uint32_t) &__extab_end)
+#define UNWIND_INDEX_START ((uint32_t) &__unwind_index_start)
+#define UNWIND_INDEX_END ((uint32_t) &__unwind_index_end)
+#define CALL_SITES_START ((uint32_t) &__unwind_calls_start)
+#define CALL_SITES_END ((uint32_t) &__unwind_calls_end)
+#endif
+
+// Little endian halfword read through aligned word loads
+#define READ_HALFWORD(address) ((READ_WORD((address) & ~0x3u) >> (((address) & 0x2) * 8)) & 0xffff)
+
+// Unwind index fields
+#define UNWIND_INDEX_FIELD(field) READ_WORD(UNWIND_INDEX_START + offsetof(unwindIndexHeader_t, field))
+#define UNWIND_INDEX_DATA (UNWIND_INDEX_START + sizeof(unwindIndexHeader_t))
+#define UNWIND_INDEX_SIZE (UNWIND_INDEX_END - UNWIND_INDEX_START)
+
+// Call sites table fields
+#define CALL_SITES_FIELD(field) READ_WORD(CALL_SITES_START + offsetof(callSitesHeader_t, field))
+#define CALL_SITES_DATA (CALL_SITES_START + sizeof(callSitesHeader_t))
+#define CALL_SITES_SIZE (CALL_SITES_END - CALL_SITES_START)
+
 /*************************** Functions Declarations **************************/
 
-void UnwindStack(callStack_t* call_stack, call_t last_call);
-void UnwindNextFrame(callStack_t* call_stack);
+void UnwindStack(callStack_t* call_stack, const unwindRegisters_t* registers);
+void UnwindStackInBounds(callStack_t* call_stack, const unwindRegisters_t* registers, stackBounds_t bounds);
+void UnwindNextFrame(callStack_t* call_stack, unwindRegisters_t* vrs, stackBounds_t bounds);
+void SetFrameHook(frameHook_t hook);
+#if CALL_STACK_RESOLVE_FN
+void ResolveCallStack(callStack_t* call_stack);
+#endif
 
-uint32_t __attribute__((pure)) DecodeFrame(uint32_t entry, uint32_t decoded_entry, uint32_t fp);
-uint32_t __attribute__((pure)) DecodeCompactModelEntry(const uint32_t entry, const uint32_t word, const uint32_t fp, const uint8_t instr_count, const uint8_t offset);
-uint32_t __attribute__((pure)) GetInstruction(const uint32_t entry, const uint32_t word, const uint8_t offset, const uint8_t offset2);
-exidxEntry_t __attribute__((pure)) GetExidxEntry(const uint8_t* const section, const uint32_t offset);
+uint32_t __attribute__((pure)) GetEntryWordCount(uint32_t entry);
+uint32_t DecodeFrame(uint32_t entry, uint32_t decoded_entry, unwindRegisters_t* vrs, stackBounds_t bounds);
+uint32_t DecodeCompactModelEntry(const uint32_t entry, const uint32_t word, unwindRegisters_t* vrs, const stackBounds_t bounds, const uint32_t instr_count, const uint32_t offset);
+uint32_t PopRegisters(unwindRegisters_t* vrs, const uint32_t mask, const stackBounds_t bounds);
+uint32_t __attribute__((pure)) GetInstruction(const uint32_t entry, const uint32_t word, const uint32_t offset, const uint32_t offset2);
+exidxEntry_t __attribute__((pure)) FindExidxEntry(const uint32_t address);
+exidxEntry_t __attribute__((pure)) SearchExidxEntry(const uint32_t address, uint32_t first, uint32_t last);
+exidxEntry_t __attribute__((pure)) FindPoolEntry(const uint32_t address);
+exidxEntry_t __attribute__((pure)) FindFrameEntry(const callStack_t* call_stack, const uint32_t index);
+uint32_t __attribute__((pure)) FindCallSite(const uint32_t return_address);
+uint32_t __attribute__((const)) HashCallSite(const uint32_t return_address, const uint32_t seed, const uint32_t range);
+void SearchPageIndex(const uint32_t address, const uint32_t entries_count, uint32_t* first, uint32_t* last);
+void SearchEytzingerIndex(const uint32_t address, const uint32_t entries_count, uint32_t* first, uint32_t* last);
+exidxEntry_t __attribute__((pure)) GetExidxEntry(const uint32_t section, const uint32_t offset);
 uint32_t __attribute__((pure)) DecodePrel31(const uint32_t word, const uint32_t where);
-uint32_t __attribute__((pure)) GetWord(const uint8_t* const section, const uint32_t offset);
+uint32_t __attribute__((pure)) GetWord(const uint32_t section, const uint32_t offset);
 
 /*************************** Handlers Declarations ***************************/
 
 /*************************** Variables Definitions ***************************/
 
+/**
+ * @brief Function called each time a frame has been unwound (may be NULL)
+ */
+static frameHook_t frame_hook = 0;
+
 /*************************** Functions Definitions ***************************/
 
 /**
- * @brief This function makes an unwind to compute the stacktrace from the program
- * counter variable.
+ * @brief This function sets the function called each time a frame has been unwound,
+ * so that frames can be streamed while the unwind is still running.
+ * @param[in] hook                    The function to call, 0 to disable
+ * @return Nothing
+ */
+void SetFrameHook(frameHook_t hook)
+{
+    frame_hook = hook;
+}
+
+/**
+ * @brief This function makes an unwind to compute the stacktrace from the registers of
+ * the interrupted context.
+ * @param[out] call_stack             The structure where to store the stracktrace
+ * @param[in] registers               The registers of the interrupted context (r0-r15)
+ * @return Nothing
+ */
+void UnwindStack(callStack_t* call_stack, const unwindRegisters_t* registers)
+{
+    stackBounds_t bounds = { .low = 0x0, .high = UNWIND_END };
+
+    UnwindStackInBounds(call_stack, registers, bounds);
+}
+
+/**
+ * @brief This function makes an unwind to compute the stacktrace, only reading frames
+ * that lie within the given stack bounds.
+ * @note The virtual register set starts as the interrupted context (pc, lr, sp and the
+ * callee-saved registers) and is carried from frame to frame (EHABI Section 10.3) : each
+ * frame is decoded from the stack pointer of its callee, whatever registers it uses. The
+ * walk stops on the first frame outside of the bounds, so that a corrupted stack never
+ * leads to a read outside of it.
  * @param[out] call_stack             The structure where to store the stracktrace
- * @param[in] last_call               The unwind context (lr + fp)
+ * @param[in] registers               The registers of the interrupted context (r0-r15)
+ * @param[in] bounds                  The memory range of the stack being unwound
  * @return Nothing
  */
-void UnwindStack(callStack_t* call_stack, call_t last_call)
+void UnwindStackInBounds(callStack_t* call_stack, const unwindRegisters_t* registers, stackBounds_t bounds)
 {
+    unwindRegisters_t vrs = *registers;
+
     call_stack->size = 0;
 
-    // Setup last call
-    LAST_CALL(call_stack) = last_call;
+    // The first frame is the interrupted instruction, on the interrupted stack pointer
+    vrs.popped = 0;
+    LAST_CALL(call_stack).pc = vrs.r[15];
+    LAST_CALL(call_stack).sp = vrs.r[13];
 
+    /**
+     * Frames are pushed downwards, so each caller frame lies strictly above the frame
+     * of its callee : a stack pointer that does not increase means that the stack is
+     * corrupted (or loops back on itself) and the walk stops there. Only the caller of a
+     * leaf first frame, which returns through lr, may have the same stack pointer.
+     */
     while (
         call_stack->size < CALL_STACK_MAX_SIZE
-        && LAST_CALL(call_stack).lr != 0xffffffff
-        && LAST_CALL(call_stack).fp != 0x07070707
+        && LAST_CALL(call_stack).pc != UNWIND_END
+        && (
+            call_stack->size == 0
+            || LAST_CALL(call_stack).sp > call_stack->calls[call_stack->size - 1].sp
+            || (call_stack->size == 1 && LAST_CALL(call_stack).sp == call_stack->calls[0].sp)
+        )
     )
     {
-        UnwindNextFrame(call_stack);
+        UnwindNextFrame(call_stack, &vrs, bounds);
     }
 }
 
 /**
  * @brief This function unwind the frame following the last valid address stored
  * in call_stack
- * @param[out] call_stack     The structure where to store the frame computed lr
+ * @param[out] call_stack     The structure where to store the frame computed pc
+ * @param[in,out] vrs         The virtual register set, holding the registers of the frame to
+ * unwind on entry and the ones of its caller on return
+ * @param[in] bounds          The memory range of the stack being unwound
  * @return Nothing
  */
-void UnwindNextFrame(callStack_t* call_stack)
+void UnwindNextFrame(callStack_t* call_stack, unwindRegisters_t* vrs, stackBounds_t bounds)
 {
-    /**
-     * @brief Total number of entries in the unwind table
-     */
-    uint32_t entries_count = (&__exidx_end - &__exidx_start) / 2;
-
     /**
      * @brief Unwind tables entries
      */
     uint32_t extab_entry = 0x0;
     exidxEntry_t entry = {0};
 
+    // Whether the unwinding instructions have been decoded
+    uint32_t decoded = 0x0;
+
+#if CALL_STACK_RESOLVE_FN
+    // Find the entry of the function associated with the frame to unwind
+    entry = FindFrameEntry(call_stack, call_stack->size);
+    LAST_CALL(call_stack).fn = entry.decoded_fn;
+#endif
+
+    if (frame_hook)
+    {
+        frame_hook(call_stack->size, &LAST_CALL(call_stack));
+    }
+
     /**
-     * @brief Frame pointer
+     * Move to the next call array place.
      */
-    uint32_t fp = LAST_CALL(call_stack).fp;
+    call_stack->size += 1;
 
-    // New frame pointer
-    uint32_t new_fp = 0x0;
+    // The call array is full, there is no place left to store the next frame
+    if (call_stack->size >= CALL_STACK_MAX_SIZE)
+    {
+        return;
+    }
 
+#if !CALL_STACK_RESOLVE_FN
     /**
-     * Iterate over all entries, get the function return address and find the entry
-     * corresponding to the last return address unwound (ie. the address of the function
-     * associated with the frame to unwind).
-     *
-     * TODO: Could be optimized with a dichotomic search because addresses are sorted in
-     * unwind table. The complexity would then be O(log_2(N)) instead of O(N)
+     * Lazy mode : frames only hold their raw pc, and the function is only looked up when
+     * the frame has to be unwound (never for the last frame of a full call stack).
      */
-    do {
-        entries_count--;
-        entry = GetExidxEntry((uint8_t *)&__exidx_start, 8 * entries_count);
-    } while (
-        (entries_count > 0)
-        && (entry.decoded_fn > LAST_CALL(call_stack).lr)
-    );
-
-    // TODO : See if remove this is interesting to have the exact instruction of the error
-    LAST_CALL(call_stack).lr = entry.decoded_fn;
+    entry = FindFrameEntry(call_stack, call_stack->size - 1);
+#endif
 
     /**
-     * Move to the next call array place.
+     * A first frame interrupted on the first instruction of its function has not run its
+     * prologue : nothing has been pushed yet, and the return address is still in lr.
      */
-    call_stack->size += 1;
+    if (call_stack->size == 1 && call_stack->calls[0].pc == entry.decoded_fn)
+    {
+        entry.exidx_entry = EXIDX_NO_FRAME;
+        entry.decoded_entry = EXIDX_NO_FRAME;
+    }
+
+    vrs->popped = 0;
 
     /**
      * (Section 6)
@@ -132,47 +265,493 @@ void UnwindNextFrame(callStack_t* call_stack)
      */
     if (entry.exidx_entry == EXIDX_CANTUNWIND)      // Special pattern 0x1 EXIDX_CANTUNWIND
     {
-        LAST_CALL(call_stack).lr = 0xffffffff;
-        LAST_CALL(call_stack).fp = 0xffffffff;
+        LAST_CALL(call_stack).pc = UNWIND_END;
+        LAST_CALL(call_stack).sp = UNWIND_END;
+        return;
     }
-    else if (entry.exidx_entry & 0x80000000)        // Bit 31 set --> compact model
-    {
-        new_fp = DecodeFrame(entry.exidx_entry, entry.decoded_entry, fp);
 
+    if (entry.exidx_entry & 0x80000000)             // Bit 31 set --> compact model
+    {
         /**
-         * The `lr` register is pushed just before the `fp` register, then we can get it by accessing `fp + 4`
+         * An entry encoded in the exidx word itself has no additional word : a count
+         * of extra words would make the decoder read at the address given by the entry.
          */
-        LAST_CALL(call_stack).lr = *((uint32_t *) (new_fp + 4)) - 1;
-        LAST_CALL(call_stack).fp = *((uint32_t *) new_fp);
+        if (GetEntryWordCount(entry.exidx_entry) != 1)
+        {
+            LAST_CALL(call_stack).pc = UNWIND_END;
+            LAST_CALL(call_stack).sp = UNWIND_END;
+            return;
+        }
+
+        decoded = DecodeFrame(entry.exidx_entry, entry.decoded_entry, vrs, bounds);
     }
     else                                            // Bit 31 is clear
     {
-        extab_entry = GetWord((uint8_t *) entry.decoded_entry, 0);
+        // The table entry and all its additional words must lie within `.ARM.extab`
+        if (!IN_EXTAB(entry.decoded_entry, 1))
+        {
+            LAST_CALL(call_stack).pc = UNWIND_END;
+            LAST_CALL(call_stack).sp = UNWIND_END;
+            return;
+        }
 
-        if (extab_entry & 0x80000000)
+        extab_entry = GetWord(entry.decoded_entry, 0);
+
+        if (extab_entry & 0x80000000)               // Bit 31 set --> compact model
         {
-            new_fp = DecodeFrame(extab_entry, entry.decoded_entry, fp);
+            if (
+                GetEntryWordCount(extab_entry) == 0
+                || !IN_EXTAB(entry.decoded_entry, GetEntryWordCount(extab_entry))
+            )
+            {
+                LAST_CALL(call_stack).pc = UNWIND_END;
+                LAST_CALL(call_stack).sp = UNWIND_END;
+                return;
+            }
 
+            decoded = DecodeFrame(extab_entry, entry.decoded_entry, vrs, bounds);
+        }
+        else                                        // Bit 31 clear --> generic model
+        {
             /**
-             * The `lr` register is pushed just before the `fp` register, then we can get it by accessing `fp + 4`
+             * (Section 7.2)
+             * The first word is the prel31 offset of the personality routine, followed by the data
+             * for this routine. The ARM and GNU routines (`__gxx_personality_v0`, `__gcc_personality_v0`)
+             * start it like the long compact models : a count N of additional words in bits 24-31,
+             * then the unwinding instructions packed into bits 16-23, 8-15, 0-7 and the following N words.
              */
-            LAST_CALL(call_stack).lr = *((uint32_t *) (new_fp + 4)) - 1;
-            LAST_CALL(call_stack).fp = *((uint32_t *) new_fp);
+            if (!IN_EXTAB(entry.decoded_entry, 2))
+            {
+                LAST_CALL(call_stack).pc = UNWIND_END;
+                LAST_CALL(call_stack).sp = UNWIND_END;
+                return;
+            }
+
+            extab_entry = GetWord(entry.decoded_entry, 4);
+
+            if (!IN_EXTAB(entry.decoded_entry + 4, 1 + (extab_entry >> 24)))
+            {
+                LAST_CALL(call_stack).pc = UNWIND_END;
+                LAST_CALL(call_stack).sp = UNWIND_END;
+                return;
+            }
+
+            decoded = DecodeCompactModelEntry(entry.decoded_entry + 4, extab_entry, vrs, bounds, 3 + 4 * (extab_entry >> 24), 1);
         }
     }
+
+    /**
+     * A refused or malformed frame ends the walk, as does a caller frame whose return address
+     * has not been restored : only the first frame (a leaf, or a function interrupted before
+     * its prologue) may still hold it in lr, the callers have overwritten lr with their call.
+     */
+    if (!decoded || (call_stack->size > 1 && !(vrs->popped & ((1u << 14) | (1u << 15)))))
+    {
+        LAST_CALL(call_stack).pc = UNWIND_END;
+        LAST_CALL(call_stack).sp = UNWIND_END;
+        return;
+    }
+
+    /**
+     * (Section 10.3)
+     * If r15 has not been restored by the unwinding instructions, the return address is in r14.
+     */
+    if (!(vrs->popped & (1u << 15)))
+    {
+        vrs->r[15] = vrs->r[14];
+    }
+
+    // The caller resumes at the return address (Thumb bit cleared), on the stack pointer left by the frame
+    LAST_CALL(call_stack).pc = vrs->r[15] - 1;
+    LAST_CALL(call_stack).sp = vrs->r[13];
 }
 
 /**
- * @brief This function execute the personnality routine for a given entry and
- * return the computed frame pointer
+ * @brief This function finds the unwind table entry of the function containing an address.
  * @warning This function is annotated with the `pure` attribute for
  * performance purpose, it must remain pure if it's changed
+ * @param[in] address the address to look up
+ * @return The entry of the function, or an EXIDX_CANTUNWIND entry with a null function
+ * start if no function of the unwind table contains the address
+ */
+exidxEntry_t __attribute__((pure)) FindExidxEntry(const uint32_t address)
+{
+    /**
+     * @brief Total number of entries in the unwind table
+     */
+    uint32_t entries_count = (EXIDX_END - EXIDX_START) / 8;
+
+    // Searched entries (first included, last excluded)
+    uint32_t first = 0;
+    uint32_t last = entries_count;
+
+    // When an index has been linked (see unwindgen), it narrows the searched entries or replaces them
+    if (UNWIND_INDEX_SIZE >= sizeof(unwindIndexHeader_t))
+    {
+        switch (UNWIND_INDEX_FIELD(layout))
+        {
+            case UNWIND_INDEX_POOL:
+                return FindPoolEntry(address);
+            case UNWIND_INDEX_PAGES:
+                SearchPageIndex(address, entries_count, &first, &last);
+                break;
+            case UNWIND_INDEX_EYTZINGER:
+                SearchEytzingerIndex(address, entries_count, &first, &last);
+                break;
+            default:
+                break;
+        }
+    }
+
+    return SearchExidxEntry(address, first, last);
+}
+
+/**
+ * @brief This function searches `.ARM.exidx` for the entry of the function containing an
+ * address, between two entries.
+ * @warning This function is annotated with the `pure` attribute for
+ * performance purpose, it must remain pure if it's changed
+ * @param[in] address the address to look up
+ * @param[in] first the first entry to search
+ * @param[in] last the entry following the last entry to search
+ * @return The entry of the function, or an EXIDX_CANTUNWIND entry with a null function
+ * start if no searched entry contains the address
+ */
+exidxEntry_t __attribute__((pure)) SearchExidxEntry(const uint32_t address, uint32_t first, uint32_t last)
+{
+    uint32_t middle = 0;
+
+    exidxEntry_t entry = {0};
+
+    /**
+     * Binary search of the last entry starting at or below the address, entries are sorted
+     * by function address : only the function address of the probed entries is decoded.
+     */
+    while (last - first > 1)
+    {
+        middle = first + (last - first) / 2;
+
+        if (DecodePrel31(READ_WORD(EXIDX_START + 8 * middle), EXIDX_START + 8 * middle) <= address)
+        {
+            first = middle;
+        }
+        else
+        {
+            last = middle;
+        }
+    }
+
+    if (first < last)
+    {
+        entry = GetExidxEntry(EXIDX_START, 8 * first);
+    }
+
+    if (first >= last || entry.decoded_fn > address)
+    {
+        entry = (exidxEntry_t) {0};
+        entry.exidx_entry = EXIDX_CANTUNWIND;
+    }
+
+    return entry;
+}
+
+/**
+ * @brief This function narrows the entries that may contain an address with the page index :
+ * only the entries between the one containing the start of the page and the one containing
+ * the start of the next page are kept, which usually fit in a single cache line.
+ * @param[in] address the address to look up
+ * @param[in] entries_count the number of entries of the unwind table
+ * @param[out] first the first entry to search
+ * @param[out] last the entry following the last entry to search
+ * @return Nothing, the range is left untouched if the address is outside of the index (or if
+ * the index is malformed)
+ */
+void SearchPageIndex(const uint32_t address, const uint32_t entries_count, uint32_t* first, uint32_t* last)
+{
+    uint32_t page = 0;
+
+    if (address < UNWIND_INDEX_FIELD(base) || UNWIND_INDEX_FIELD(page_shift) >= 32 || UNWIND_INDEX_FIELD(count) > 0x10000)
+    {
+        return;
+    }
+
+    page = (address - UNWIND_INDEX_FIELD(base)) >> UNWIND_INDEX_FIELD(page_shift);
+
+    if (
+        page < UNWIND_INDEX_FIELD(count)
+        && UNWIND_INDEX_SIZE >= sizeof(unwindIndexHeader_t) + 2 * (page + 2)
+        && READ_HALFWORD(UNWIND_INDEX_DATA + 2 * (page + 1)) < entries_count
+        && READ_HALFWORD(UNWIND_INDEX_DATA + 2 * page) <= READ_HALFWORD(UNWIND_INDEX_DATA + 2 * (page + 1))
+    )
+    {
+        *first = READ_HALFWORD(UNWIND_INDEX_DATA + 2 * page);
+        *last = READ_HALFWORD(UNWIND_INDEX_DATA + 2 * (page + 1)) + 1;
+    }
+}
+
+/**
+ * @brief This function finds the entry containing an address with the Eytzinger index : the
+ * function addresses are stored in BFS order, so that the first levels of the search share
+ * a few cache lines and each level is a load and a comparison without branch.
+ * @param[in] address the address to look up
+ * @param[in] entries_count the number of entries of the unwind table
+ * @param[out] first the entry containing the address
+ * @param[out] last the entry following it
+ * @return Nothing, the range is left untouched if the index does not match the unwind table
+ */
+void SearchEytzingerIndex(const uint32_t address, const uint32_t entries_count, uint32_t* first, uint32_t* last)
+{
+    uint32_t count = UNWIND_INDEX_FIELD(count);
+    uint32_t keys = UNWIND_INDEX_DATA;
+    uint32_t entries = UNWIND_INDEX_DATA + 4 * (count + 1);
+    uint32_t node = 1;
+    uint32_t entry = 0;
+
+    if (count != entries_count || UNWIND_INDEX_SIZE < sizeof(unwindIndexHeader_t) + 6 * (count + 1))
+    {
+        return;
+    }
+
+    // Left (0) or right (1) turns are shifted in the node number
+    while (node <= count)
+    {
+        node = 2 * node + (READ_WORD(keys + 4 * node) <= address);
+    }
+
+    // Dropping the trailing right turns and the last left turn gives the first function above the address
+    node >>= __builtin_ffs(~node);
+
+    // The address belongs to the entry before this function, or to the last one if there is none
+    entry = node == 0 ? count : READ_HALFWORD(entries + 2 * node);
+
+    if (entry > count)
+    {
+        return;
+    }
+
+    *first = entry == 0 ? 0 : entry - 1;
+    *last = entry;
+}
+
+/**
+ * @brief This function finds the unwind program of an address in the program pool : adjacent
+ * functions sharing the same program are collapsed in a single range, so the search covers
+ * fewer entries than `.ARM.exidx`, and identical programs are stored once.
+ * @note The function of the returned entry is the start of the range, which is the first of
+ * the functions sharing its program : builds linking the pool leave `call_t.fn` to
+ * ResolveCallStack (CALL_STACK_RESOLVE_FN set to 0).
+ * @warning This function is annotated with the `pure` attribute for
+ * performance purpose, it must remain pure if it's changed
+ * @param[in] address the address to look up
+ * @return The entry of the range, with the program decoded as in `.ARM.exidx`
+ * (EXIDX_CANTUNWIND if the address is outside of the ranges or if the pool is truncated)
+ */
+exidxEntry_t __attribute__((pure)) FindPoolEntry(const uint32_t address)
+{
+    uint32_t count = UNWIND_INDEX_FIELD(count);
+    uint32_t pool_count = UNWIND_INDEX_FIELD(pool_count);
+    uint32_t starts = UNWIND_INDEX_DATA;
+    uint32_t pool = starts + 4 * count;
+    uint32_t programs = pool + 4 * pool_count;
+    uint32_t first = 0;
+    uint32_t last = count;
+    uint32_t middle = 0;
+    uint32_t program = 0;
+
+    exidxEntry_t entry = {0};
+
+    entry.exidx_entry = EXIDX_CANTUNWIND;
+
+    if (
+        count == 0 || count > 0x10000 || pool_count > 0x10000
+        || UNWIND_INDEX_SIZE < sizeof(unwindIndexHeader_t) + 6 * count + 4 * pool_count
+    )
+    {
+        return entry;
+    }
+
+    // Binary search of the last range starting at or below the address
+    while (last - first > 1)
+    {
+        middle = first + (last - first) / 2;
+
+        if (READ_WORD(starts + 4 * middle) <= address)
+        {
+            first = middle;
+        }
+        else
+        {
+            last = middle;
+        }
+    }
+
+    program = READ_HALFWORD(programs + 2 * first);
+
+    if (READ_WORD(starts + 4 * first) > address || program >= pool_count)
+    {
+        return entry;
+    }
+
+    entry.exidx_fn = READ_WORD(starts + 4 * first);
+    entry.decoded_fn = entry.exidx_fn;
+    entry.exidx_entry = READ_WORD(pool + 4 * program);
+
+    // Table entries are pooled by offset, `.ARM.extab` may move between the two links
+    entry.decoded_entry = entry.exidx_entry & 0x80000000 || entry.exidx_entry == EXIDX_CANTUNWIND
+        ? entry.exidx_entry
+        : EXTAB_START + entry.exidx_entry;
+
+    return entry;
+}
+
+/**
+ * @brief This function finds the unwind table entry of a frame. When the call sites table has
+ * been linked (see unwindgen), the return address of the frames above the first one is looked
+ * up in it : a return address that does not follow a `BL` / `BLX` comes from a corrupted stack,
+ * and gets the EXIDX_CANTUNWIND entry so that the walk stops on this frame.
+ * @warning This function is annotated with the `pure` attribute for
+ * performance purpose, it must remain pure if it's changed
+ * @param[in] call_stack the call stack holding the frame
+ * @param[in] index the index of the frame
+ * @return The entry of the function of the frame
+ */
+exidxEntry_t __attribute__((pure)) FindFrameEntry(const callStack_t* call_stack, const uint32_t index)
+{
+    uint32_t entry_index = 0;
+    exidxEntry_t entry = {0};
+
+    if (index == 0 || CALL_SITES_SIZE < sizeof(callSitesHeader_t))
+    {
+        return FindExidxEntry(CALL_SITE(call_stack, index));
+    }
+
+    entry_index = FindCallSite(call_stack->calls[index].pc);
+
+    if (entry_index >= (EXIDX_END - EXIDX_START) / 8)
+    {
+        entry.exidx_entry = EXIDX_CANTUNWIND;
+        return entry;
+    }
+
+    return GetExidxEntry(EXIDX_START, 8 * entry_index);
+}
+
+/**
+ * @brief This function looks a return address up in the call sites table, a minimal perfect
+ * hash (hash and displace) : the address selects a bucket, the displacement of the bucket
+ * selects the slot, whose stored address tells whether it really is a call site. A lookup
+ * is two hashes and three loads, whatever the size of the image.
+ * @warning This function is annotated with the `pure` attribute for
+ * performance purpose, it must remain pure if it's changed
+ * @param[in] return_address the return address (Thumb bit cleared)
+ * @return The index of the `.ARM.exidx` entry of the calling function, CALL_SITE_UNKNOWN if the
+ * address is not a call site (or if the table is truncated)
+ */
+uint32_t __attribute__((pure)) FindCallSite(const uint32_t return_address)
+{
+    uint32_t seed = CALL_SITES_FIELD(seed);
+    uint32_t bucket_count = CALL_SITES_FIELD(bucket_count);
+    uint32_t count = CALL_SITES_FIELD(count);
+    uint32_t keys = CALL_SITES_DATA;
+    uint32_t displacements = keys + 4 * count;
+    uint32_t entries = displacements + 2 * bucket_count;
+    uint32_t displacement = 0;
+    uint32_t slot = 0;
+
+    if (
+        count == 0 || bucket_count == 0 || count > 0x10000 || bucket_count > 0x10000
+        || CALL_SITES_SIZE < sizeof(callSitesHeader_t) + 6 * count + 2 * bucket_count
+    )
+    {
+        return CALL_SITE_UNKNOWN;
+    }
+
+    displacement = READ_HALFWORD(displacements + 2 * HashCallSite(return_address, seed, bucket_count));
+    slot = HashCallSite(return_address, CALL_SITES_SLOT_SEED(seed, displacement), count);
+
+    if (READ_WORD(keys + 4 * slot) != return_address)
+    {
+        return CALL_SITE_UNKNOWN;
+    }
+
+    return READ_HALFWORD(entries + 2 * slot);
+}
+
+/**
+ * @brief This function hashes a return address (murmur3 finalizer) into a range, with a
+ * multiplication instead of a division (UMULL on the Cortex-M7).
+ * @param[in] return_address the return address
+ * @param[in] seed the seed of the hash
+ * @param[in] range the number of possible values
+ * @return The hash, lower than range
+ */
+uint32_t __attribute__((const)) HashCallSite(const uint32_t return_address, const uint32_t seed, const uint32_t range)
+{
+    uint32_t hash = return_address ^ seed;
+
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+
+    return (uint32_t) (((uint64_t) hash * range) >> 32);
+}
+
+#if CALL_STACK_RESOLVE_FN
+/**
+ * @brief This function writes the function start of each frame of a call stack, when
+ * the unwinder has not done it (CALL_STACK_RESOLVE_FN set to 0).
+ * @note The pool index only holds the start of the ranges of functions sharing a program,
+ * when it is linked the exact function start is searched in `.ARM.exidx` itself.
+ * @param[in,out] call_stack  The call stack to resolve
+ * @return Nothing
+ */
+void ResolveCallStack(callStack_t* call_stack)
+{
+    uint8_t pool = UNWIND_INDEX_SIZE >= sizeof(unwindIndexHeader_t) && UNWIND_INDEX_FIELD(layout) == UNWIND_INDEX_POOL;
+
+    for (uint32_t index = 0; index < call_stack->size && index < CALL_STACK_MAX_SIZE; index++)
+    {
+        call_stack->calls[index].fn = pool
+            ? SearchExidxEntry(CALL_SITE(call_stack, index), 0, (EXIDX_END - EXIDX_START) / 8).decoded_fn
+            : FindFrameEntry(call_stack, index).decoded_fn;
+    }
+}
+#endif
+
+/**
+ * @brief This function computes the number of words of a compact model table entry
+ * (the first word and the additional words holding unwinding instructions).
+ * @warning This function is annotated with the `pure` attribute for
+ * performance purpose, it must remain pure if it's changed
+ * @param[in] entry the first word of the table entry
+ * @return The number of words of the entry, 0 if the personality index is reserved
+ */
+uint32_t __attribute__((pure)) GetEntryWordCount(const uint32_t entry)
+{
+    switch ((uint8_t) ((entry >> 24) & 0xf))
+    {
+        case SU16:
+            return 1;
+        case LU16:
+        case LU32:
+            return 1 + ((entry >> 16) & 0xff);
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief This function execute the personnality routine for a given entry, updating
+ * the virtual register set with the registers of the caller
  * @param[in] entry the exidx/extab entryn(depending on its format) of the frame to decode
  * @param[in] decoded_entry the decoded exidx entry of the frame to decode
- * @param[in] fp the old frame pointer (used to unwind the next step)
- * @return The new frame pointer
+ * @param[in,out] vrs the virtual register set of the frame (used to unwind the next step)
+ * @param[in] bounds the memory range the popped registers may be read from
+ * @return 1 if the frame has been decoded, 0 if it cannot be unwound
  */
-uint32_t __attribute__((pure)) DecodeFrame(const uint32_t entry, const uint32_t decoded_entry, const uint32_t fp) {
+uint32_t DecodeFrame(const uint32_t entry, const uint32_t decoded_entry, unwindRegisters_t* vrs, const stackBounds_t bounds) {
     /**
      * (Section 10.2)
      * The first word is as described in The Arm-defined compact model.
@@ -189,8 +768,8 @@ uint32_t __attribute__((pure)) DecodeFrame(const uint32_t entry, const uint32_t
      */
     uint32_t instr_count = (word >> 16) & 0xff;
 
-    // Initialize the new frame pointer
-    uint32_t new_fp = fp;
+    // Whether the frame has been decoded
+    uint32_t decoded = 0x0;
 
     /**
      * (Section 7.3)
@@ -216,7 +795,7 @@ uint32_t __attribute__((pure)) DecodeFrame(const uint32_t entry, const uint32_t
          * Short 3 unwinding instructions in bits 16-23, 8-15, and 0-7 of the first word. Any of the instructions can be Finish.
          */
         case SU16:
-            new_fp = DecodeCompactModelEntry(decoded_entry, word, fp, 3, 1);
+            decoded = DecodeCompactModelEntry(decoded_entry, word, vrs, bounds, 3, 1);
             break;
         /**
          * (Section 10.2)
@@ -225,41 +804,44 @@ uint32_t __attribute__((pure)) DecodeFrame(const uint32_t entry, const uint32_t
          * Spare trailing bytes in the last word should be filled with Finish instructions.
          */
         case LU16:
-            new_fp = DecodeCompactModelEntry(decoded_entry, word, fp, 2 + 4 * instr_count, 2);
+            decoded = DecodeCompactModelEntry(decoded_entry, word, vrs, bounds, 2 + 4 * instr_count, 2);
             break;
         case LU32:
-            new_fp = DecodeCompactModelEntry(decoded_entry, word, fp, 2 + 4 * instr_count, 2);
+            decoded = DecodeCompactModelEntry(decoded_entry, word, vrs, bounds, 2 + 4 * instr_count, 2);
             break;
         default:
-            // error
+            // Reserved personality index
             break;
     }
 
-    return new_fp;
+    return decoded;
 }
 
 /**
- * @brief This function decodes unwind instructions based on ARM EHABI standard.
- * @warning This function is annotated with the `pure` attribute for
- * performance purpose, it must remain pure if it's changed
+ * @brief This function decodes unwind instructions based on ARM EHABI standard (Section 10.3),
+ * every opcode form is executed on the virtual register set : the core registers are popped
+ * from the stack, the VFP and iWMMX registers are skipped by moving vsp over them.
  * @param[in] entry_ptr the address of the words to decode
  * @param[in] word the original word decoded
- * @param[in] fp the old frame pointer
+ * @param[in,out] vrs the virtual register set
+ * @param[in] bounds the memory range the popped registers may be read from
  * @param[in] instr_count the number of instructions
  * @param[in] offset a specific offset within the word (= 1 or 2 depending of the compact model index)
- * @return The new frame pointer
+ * @return 1 if the instructions have been decoded up to `finish` or to the last one, 0 on
+ * `Refuse to unwind`, on a spare or truncated instruction, or on a pop outside of the bounds
  */
-uint32_t __attribute__((pure)) DecodeCompactModelEntry(const uint32_t entry_ptr, const uint32_t word, const uint32_t fp, const uint8_t instr_count, const uint8_t offset)
+uint32_t DecodeCompactModelEntry(const uint32_t entry_ptr, const uint32_t word, unwindRegisters_t* vrs, const stackBounds_t bounds, const uint32_t instr_count, const uint32_t offset)
 {
     // Instructions to fetch
     uint32_t instr1 = 0x0;
     uint32_t instr2 = 0x0;
 
-    // Instruction counter
-    uint8_t instr_index = 0x0;
+    // Instruction counter (up to 2 + 4 * 255 instructions for the long models)
+    uint32_t instr_index = 0x0;
 
-    // New frame pointer
-    uint32_t new_fp = fp;
+    // ULEB128 operand of the large vsp increments
+    uint32_t uleb128 = 0x0;
+    uint32_t shift = 0x0;
 
     // Condition representing whether there is a second instruction to fetch (because of the posibility to fetch two instructions in one)
     uint8_t double_instr = 0x0;
@@ -280,7 +862,7 @@ uint32_t __attribute__((pure)) DecodeCompactModelEntry(const uint32_t entry_ptr,
              * @brief 00xxxxxx
              * vsp = vsp + (xxxxxx << 2) + 4. Covers range 0x04-0x100 inclusive
              */
-            new_fp += SIX_RIGHT_MASK(instr1) + 4;
+            vrs->r[13] += SIX_RIGHT_MASK(instr1) + 4;
         }
         else if ((instr1 & 0xc0) == 0x40)
         {
@@ -288,47 +870,186 @@ uint32_t __attribute__((pure)) DecodeCompactModelEntry(const uint32_t entry_ptr,
              * @brief 01xxxxxx
              * vsp = vsp – (xxxxxx << 2) - 4. Covers range 0x04-0x100 inclusive
              */
-            new_fp -= SIX_RIGHT_MASK(instr1) - 4;
+            vrs->r[13] -= SIX_RIGHT_MASK(instr1) + 4;
+        }
+        else if ((instr1 & 0xf0) == 0x80)
+        {
+            /**
+             * @brief 10000000 00000000 : Refuse to unwind
+             * 1000iiii iiiiiiii : Pop up to 12 integer registers under masks {r15-r12}, {r11-r4}
+             */
+            if (
+                !double_instr
+                || (instr1 == 0x80 && instr2 == 0x00)
+                || !PopRegisters(vrs, (((instr1 & 0x0f) << 8) | instr2) << 4, bounds)
+            )
+            {
+                return 0;
+            }
+            instr_index++;
+        }
+        else if ((instr1 & 0xf0) == 0x90)
+        {
+            /**
+             * @brief 1001nnnn ([nnnn] != 13, 15)
+             * Set vsp = r[nnnn], 10011101 and 10011111 are reserved
+             */
+            if (instr1 == 0x9d || instr1 == 0x9f)
+            {
+                return 0;
+            }
+            vrs->r[13] = vrs->r[instr1 & 0x0f];
+        }
+        else if ((instr1 & 0xf0) == 0xa0)
+        {
+            /**
+             * @brief 10100nnn / 10101nnn
+             * Pop r4-r[4+nnn], then r14 for 10101nnn
+             */
+            if (!PopRegisters(vrs, (((0x2u << (instr1 & 0x07)) - 1) << 4) | ((instr1 & 0x08) ? (1u << 14) : 0), bounds))
+            {
+                return 0;
+            }
+        }
+        else if (instr1 == 0xb0)
+        {
+            /**
+             * @brief 10110000
+             * Finish, the following instructions are ignored
+             */
+            break;
+        }
+        else if (instr1 == 0xb1)
+        {
+            /**
+             * @brief 10110001 0000iiii ([iiii] != 0)
+             * Pop integer registers under mask {r3, r2, r1, r0}, other forms are spare
+             */
+            if (!double_instr || instr2 == 0x00 || (instr2 & 0xf0) || !PopRegisters(vrs, instr2, bounds))
+            {
+                return 0;
+            }
+            instr_index++;
         }
-        else if (double_instr && (instr1 == 0x80) && (instr2 == 0x00))             { instr_index++; }
-        else if (double_instr && (instr1 & 0xf0) == 0x80)                          { instr_index++; }
-        else if ((instr1 == 0x9d))                                                 { }
-        else if ((instr1 == 0x9f))                                                 { }
-        else if ((instr1 & 0xf0) == 0x90)                                          { }
-        else if ((instr1 & 0xf8) == 0xa0)                                          { }
-        else if ((instr1 & 0xf8) == 0xa8)                                          { }
-        else if ((instr1 == 0xb0))                                                 { }
-        else if (double_instr && (instr1 == 0xb1) && (instr2 == 0x00))             { instr_index++; }
-        else if (double_instr && (instr1 == 0xb1) && ((instr2 & 0xf0) == 0x00))    { instr_index++; }
-        else if (double_instr && (instr1 == 0xb1))                                 { instr_index++; }
-        else if (double_instr && (instr1 == 0xb2))
+        else if (instr1 == 0xb2)
         {
             /**
              * @brief 10110010 uleb128
              * vsp = vsp + 0x204+ (uleb128 << 2) (for vsp increments of 0x104-0x200, use 00xxxxxx twice)
              */
-            new_fp += 0x204 + (instr2 << 2);
+            uleb128 = 0x0;
+            shift = 0x0;
+
+            do
+            {
+                if (++instr_index >= instr_count)
+                {
+                    return 0;
+                }
+                instr2 = GetInstruction(entry_ptr, word, instr_index, offset);
+                uleb128 |= shift < 32 ? (instr2 & 0x7f) << shift : 0;
+                shift += 7;
+            } while (instr2 & 0x80);
+
+            vrs->r[13] += 0x204 + (uleb128 << 2);
+        }
+        else if (instr1 == 0xb3 || instr1 == 0xc6 || instr1 == 0xc8 || instr1 == 0xc9)
+        {
+            /**
+             * @brief 10110011 sssscccc : Pop VFP double-precision registers D[ssss]-D[ssss+cccc] saved by FSTMFDX
+             * 11000110 sssscccc : Pop iWMMX wR[ssss]-wR[ssss+cccc]
+             * 11001000 sssscccc : Pop VFP double precision registers D[16+ssss]-D[16+ssss+cccc] saved by VPUSH
+             * 11001001 sssscccc : Pop VFP double precision registers D[ssss]-D[ssss+cccc] saved by VPUSH
+             * FSTMFDX stores a format word after the registers.
+             */
+            if (!double_instr || (instr2 >> 4) + (instr2 & 0x0f) > 15)
+            {
+                return 0;
+            }
+            vrs->r[13] += 8 * ((instr2 & 0x0f) + 1) + (instr1 == 0xb3 ? 4 : 0);
             instr_index++;
         }
-        else if (double_instr && (instr1 == 0xb3))                                 { instr_index++; }
-        else if ((instr1 == 0xb4))                                                 { }
-        else if ((instr1 & 0xf8) == 0xb8)                                          { }
-        else if ((instr1 & 0xf8) == 0xc0)                                          { }
-        else if (double_instr && (instr1 == 0xc6))                                 { instr_index++; }
-        else if (double_instr && (instr1 == 0xc7) && (instr2 == 0x00))             { instr_index++; }
-        else if (double_instr && (instr1 == 0xc7) && ((instr2 & 0xf0) == 0x00))    { instr_index++; }
-        else if (double_instr && (instr1 == 0xc7))                                 { instr_index++; }
-        else if (double_instr && (instr1 == 0xc8))                                 { instr_index++; }
-        else if (double_instr && (instr1 == 0xc9))                                 { instr_index++; }
-        else if ((instr1 & 0xf8) == 0xc8)                                          { }
-        else if ((instr1 & 0xf8) == 0xd0)                                          { }
-        else if ((instr1 & 0xc0) == 0xc0)                                          { }
-        else { }
+        else if ((instr1 & 0xf8) == 0xb8 || (instr1 & 0xf8) == 0xd0)
+        {
+            /**
+             * @brief 10111nnn : Pop VFP double-precision registers D[8]-D[8+nnn] saved by FSTMFDX
+             * 11010nnn : Pop VFP double-precision registers D[8]-D[8+nnn] saved by VPUSH
+             */
+            vrs->r[13] += 8 * ((instr1 & 0x07) + 1) + ((instr1 & 0xf8) == 0xb8 ? 4 : 0);
+        }
+        else if ((instr1 & 0xf8) == 0xc0 && instr1 != 0xc7)
+        {
+            /**
+             * @brief 11000nnn ([nnn] != 6, 7)
+             * Pop iWMMX wR[10]-wR[10+nnn]
+             */
+            vrs->r[13] += 8 * ((instr1 & 0x07) + 1);
+        }
+        else if (instr1 == 0xc7)
+        {
+            /**
+             * @brief 11000111 0000iiii ([iiii] != 0)
+             * Pop iWMMX wCGR registers under mask {wCGR3,2,1,0}, other forms are spare
+             */
+            if (!double_instr || instr2 == 0x00 || (instr2 & 0xf0))
+            {
+                return 0;
+            }
+            vrs->r[13] += 4 * __builtin_popcount(instr2);
+            instr_index++;
+        }
+        else
+        {
+            /**
+             * @brief 10110100-10110111, 11001yyy (yyy != 000, 001), 11xxxyyy (xxx != 000, 001, 010)
+             * Spare, the frame cannot be unwound
+             */
+            return 0;
+        }
 
         instr_index++;
     }
 
-    return new_fp;
+    return 1;
+}
+
+/**
+ * @brief This function pops core registers from the stack of the virtual register set,
+ * lowest register first.
+ * @param[in,out] vrs the virtual register set
+ * @param[in] mask the registers to pop (bit n for rn)
+ * @param[in] bounds the memory range the registers may be read from
+ * @return 1 if the registers have been popped, 0 if a register lies outside of the bounds
+ */
+uint32_t PopRegisters(unwindRegisters_t* vrs, const uint32_t mask, const stackBounds_t bounds)
+{
+    uint32_t vsp = vrs->r[13];
+
+    for (uint32_t reg = 0; reg < 16; reg++)
+    {
+        if (!(mask & (1u << reg)))
+        {
+            continue;
+        }
+
+        if ((vsp & 0x3) || vsp < bounds.low || vsp >= bounds.high || bounds.high - vsp < 4)
+        {
+            return 0;
+        }
+
+        vrs->r[reg] = READ_WORD(vsp);
+        vsp += 4;
+    }
+
+    // A popped r13 is the new vsp, instead of the address following the popped registers
+    if (!(mask & (1u << 13)))
+    {
+        vrs->r[13] = vsp;
+    }
+
+    vrs->popped |= mask;
+
+    return 1;
 }
 
 /**
@@ -341,19 +1062,22 @@ uint32_t __attribute__((pure)) DecodeCompactModelEntry(const uint32_t entry_ptr,
  * @param[in] offset2 the offset in the word
  * @return The instruction contained at address of entry_ptr with given offsets
  */
-uint32_t __attribute__((pure)) GetInstruction(const uint32_t entry_ptr, const uint32_t word, const uint8_t offset, const uint8_t offset2)
+uint32_t __attribute__((pure)) GetInstruction(const uint32_t entry_ptr, const uint32_t word, const uint32_t offset, const uint32_t offset2)
 {
     uint32_t instr = 0x0;
     uint32_t new_word = word;
 
-    // Calculate which word we need to access based on the offset
+    /**
+     * The first word holds `4 - offset2` instructions, the following words hold 4 instructions
+     * each, starting from their most significant byte.
+     */
     if (offset >= 4 - offset2)
     {
         // Fetch a new word from memory using GetWord when offset crosses word boundaries
-        new_word = GetWord((uint8_t *) entry_ptr, 4 * ((offset - offset2) / 4 + 1));
+        new_word = GetWord(entry_ptr, 4 * ((offset - (4 - offset2)) / 4 + 1));
 
-        // A bit of magic calculations
-        instr = (new_word >> (24 - ((offset - offset2) % 4) * 8)) & 0xff;
+        // Select the byte of the additional word
+        instr = (new_word >> (24 - ((offset - (4 - offset2)) % 4) * 8)) & 0xff;
     } else {
         // A bit of magic calculations
         instr = (new_word >> (24 - ((offset + offset2) % 4) * 8)) & 0xff;
@@ -366,15 +1090,17 @@ uint32_t __attribute__((pure)) GetInstruction(const uint32_t entry_ptr, const ui
  * @brief This function decodes an entry in the Exidx (Exception Index) Table.
  * @warning This function is annotated with the `pure` attribute for
  * performance purpose, it must remain pure if it's changed
- * @param[in] section
+ * @param[in] section the address of the section
  * @param[in] offset
  * @return The exidx entry in both raw and decoded forms (exidxEntry_t)
  */
-exidxEntry_t __attribute__((pure)) GetExidxEntry(const uint8_t* const section, const uint32_t offset)
+exidxEntry_t __attribute__((pure)) GetExidxEntry(const uint32_t section, const uint32_t offset)
 {
     exidxEntry_t entry;
-    entry.exidx_fn = GetWord(section, offset);
-    entry.exidx_entry = GetWord(section, offset+4);
+
+    // Entries are pairs of words in a word aligned table (linker script), read with aligned loads
+    entry.exidx_fn = READ_WORD(section + offset);
+    entry.exidx_entry = READ_WORD(section + offset + 4);
 
     /**
      * (Section 6)
@@ -382,11 +1108,11 @@ exidxEntry_t __attribute__((pure)) GetExidxEntry(const uint8_t* const section, c
     */
     entry.decoded_fn = entry.exidx_fn & 0x80000000
         ? 0
-        : DecodePrel31(entry.exidx_fn, (uint32_t) section + offset);
+        : DecodePrel31(entry.exidx_fn, section + offset);
 
     entry.decoded_entry = entry.exidx_entry & 0x80000000
         ? entry.exidx_entry
-        : DecodePrel31(entry.exidx_entry, (uint32_t) section + offset + 4);
+        : DecodePrel31(entry.exidx_entry, section + offset + 4);
 
     return entry;
 }
@@ -420,13 +1146,25 @@ uint32_t __attribute__((pure)) DecodePrel31(const uint32_t word, const uint32_t
  * @brief This gets a word in a given offset of the section in parameter.
  * @warning This function is annotated with the `pure` attribute for
  * performance purpose, it must remain pure if it's changed
- * @param[in] section
+ * @param[in] section the address of the section
  * @param[in] offset
  * @return The 32-bit word at the specified offset.
  */
-uint32_t __attribute__((pure)) GetWord(const uint8_t* const section, const uint32_t offset)
+uint32_t __attribute__((pure)) GetWord(const uint32_t section, const uint32_t offset)
 {
-    uint8_t const* const field = section + offset;
+#ifdef STACKTRACE_HOST
+    return READ_WORD(section + offset);
+#else
+    uint8_t const* const field = (uint8_t const*) (section + offset);
+
+    /**
+     * `.ARM.exidx` and `.ARM.extab` are word aligned (linker script) and the core is little
+     * endian : a single load is enough, bytes are only assembled for unaligned addresses.
+     */
+    if (!((section + offset) & 0x3))
+    {
+        return READ_WORD(section + offset);
+    }
 
     return (
         field[0]
@@ -434,4 +1172,5 @@ uint32_t __attribute__((pure)) GetWord(const uint8_t* const section, const uint3
         | (field[2] << 16)
         | (field[3] << 24)
     );
-}
+#endif
+}
\ No newline at end of file
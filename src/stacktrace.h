@@ -17,13 +17,37 @@
 
 #define CALL_STACK_MAX_SIZE 20u
 
+// Layouts of the `.unwind_index` section (see unwindgen)
+#define UNWIND_INDEX_PAGES 0x1u
+#define UNWIND_INDEX_EYTZINGER 0x2u
+#define UNWIND_INDEX_POOL 0x3u
+
+// Result of FindCallSite for an address that is not the return address of a call
+#define CALL_SITE_UNKNOWN 0xffffffffu
+
+// Seed of the slot hash of a call sites bucket, from its displacement (see FindCallSite)
+#define CALL_SITES_SLOT_SEED(seed, displacement) ((seed) ^ (0x9e3779b9u * ((displacement) + 1)))
+
+/**
+ * When set to 0 (lazy mode), the unwinder only records the raw pc of the frames and
+ * `call_t` has no function start (`fn`) : it is resolved on host with ResolveCallStack
+ * (see `crashdecode` and `dumpunwind`), whose call stacks always hold it.
+ */
+#ifndef CALL_STACK_RESOLVE_FN
+#define CALL_STACK_RESOLVE_FN 1
+#endif
+
+#if defined(STACKTRACE_HOST) && !CALL_STACK_RESOLVE_FN
+#error "The host tools resolve the function starts, CALL_STACK_RESOLVE_FN must be set"
+#endif
+
 /***************************** Types Definitions *****************************/
 
 /**
  * @struct  exidxEntry_t
  * @brief   Structure that handle exidx raw and decoded entries
  */
-typedef struct __attribute__((packed))
+typedef struct
 {
     uint32_t exidx_entry;
     uint32_t exidx_fn;
@@ -34,21 +58,80 @@ typedef struct __attribute__((packed))
 /**
  * @brief Structure to store details of a single stack frame.
  */
-typedef struct __attribute__((packed))
+typedef struct
 {
-    uint32_t lr;                    /**< Link register (LR) of the frame.    */
-    uint32_t fp;                    /**< Frame pointer (FP) of the frame.    */
+    uint32_t pc;                    /**< Faulting or return address.         */
+#if CALL_STACK_RESOLVE_FN
+    uint32_t fn;                    /**< Start of the function of the frame. */
+#endif
+    uint32_t sp;                    /**< Stack pointer (SP) of the frame.    */
 } call_t;
 
 /**
  * @brief Structure to represent the call stack.
  */
-typedef struct __attribute__((packed))
+typedef struct
 {
     uint32_t size;                      /**< Number of valid frames.         */
     call_t calls[CALL_STACK_MAX_SIZE];  /**< Array of captured frames.       */
 } callStack_t;
 
+/**
+ * @brief Structure to represent the memory range a stack walk may read.
+ */
+typedef struct
+{
+    uint32_t low;                       /**< Lowest readable address.        */
+    uint32_t high;                      /**< Highest readable address (excl).*/
+} stackBounds_t;
+
+/**
+ * @brief Virtual register set of the unwinding instructions (EHABI Section 10.3), holding
+ * the registers of the caller once a frame has been decoded.
+ */
+typedef struct
+{
+    uint32_t r[16];                     /**< Core registers, r13 is vsp.     */
+    uint32_t popped;                    /**< Mask of the restored registers. */
+} unwindRegisters_t;
+
+/**
+ * @brief Header of the index of `.ARM.exidx` (see unwindgen), followed by :
+ *   - UNWIND_INDEX_PAGES : `count + 1` halfwords, the entry containing the start of each page.
+ *   - UNWIND_INDEX_EYTZINGER : `count + 1` words, the function addresses in Eytzinger (BFS)
+ *     order starting at 1, then `count + 1` halfwords, the entry of each of these functions.
+ *   - UNWIND_INDEX_POOL : `count` words, the start of each range of adjacent functions sharing
+ *     the same unwind program, then `pool_count` words, the distinct programs (EXIDX_CANTUNWIND,
+ *     an inline compact model word, or the offset of a table entry in `.ARM.extab`), then
+ *     `count` halfwords, the program of each range.
+ */
+typedef struct
+{
+    uint32_t layout;                    /**< UNWIND_INDEX_* layout.          */
+    uint32_t base;                      /**< Start of the first page.        */
+    uint32_t page_shift;                /**< Log2 of the page size.          */
+    uint32_t count;                     /**< Pages, functions or ranges.     */
+    uint32_t pool_count;                /**< Number of pooled programs.      */
+} unwindIndexHeader_t;
+
+/**
+ * @brief Header of the call sites table (see unwindgen) : a minimal perfect hash of the return
+ * addresses of every `BL` / `BLX` of `.text`, followed by `count` words (the return address
+ * of each slot), `bucket_count` halfwords (the displacement of each bucket) and `count`
+ * halfwords (the `.ARM.exidx` entry of the function of each slot).
+ */
+typedef struct
+{
+    uint32_t seed;                      /**< Seed of the bucket hash.        */
+    uint32_t bucket_count;              /**< Number of buckets.              */
+    uint32_t count;                     /**< Number of call sites (slots).   */
+} callSitesHeader_t;
+
+/**
+ * @brief Function called each time a frame has been unwound.
+ */
+typedef void (*frameHook_t)(uint32_t index, const call_t* call);
+
 /*************************** Variables Declarations **************************/
 
 /**
@@ -57,8 +140,44 @@ typedef struct __attribute__((packed))
 extern uint32_t __exidx_start, __exidx_end;
 extern uint32_t __extab_start, __extab_end;
 
+/**
+ * @brief Start and end addresses of the optional `.unwind_index` section.
+ */
+extern uint32_t __unwind_index_start, __unwind_index_end;
+
+/**
+ * @brief Start and end addresses of the optional `.unwind_calls` section.
+ */
+extern uint32_t __unwind_calls_start, __unwind_calls_end;
+
+#ifdef STACKTRACE_HOST
+/**
+ * @brief Target memory, provided by host tools that build the unwinder.
+ */
+extern uint32_t host_exidx_start, host_exidx_end;
+extern uint32_t host_extab_start, host_extab_end;
+extern uint32_t host_unwind_index_start, host_unwind_index_end;
+extern uint32_t host_unwind_calls_start, host_unwind_calls_end;
+extern uint32_t HostReadWord(uint32_t address);
+#endif
+
 /*************************** Functions Declarations **************************/
 
-extern void UnwindStack(callStack_t* call_stack, call_t last_call);
+extern void UnwindStack(callStack_t* call_stack, const unwindRegisters_t* registers);
+extern void UnwindStackInBounds(callStack_t* call_stack, const unwindRegisters_t* registers, stackBounds_t bounds);
+extern void SetFrameHook(frameHook_t hook);
+#if CALL_STACK_RESOLVE_FN
+extern void ResolveCallStack(callStack_t* call_stack);
+#endif
+
+extern uint32_t GetEntryWordCount(uint32_t entry);
+extern uint32_t DecodeFrame(uint32_t entry, uint32_t decoded_entry, unwindRegisters_t* vrs, stackBounds_t bounds);
+extern uint32_t GetInstruction(const uint32_t entry_ptr, const uint32_t word, const uint32_t offset, const uint32_t offset2);
+extern exidxEntry_t FindExidxEntry(const uint32_t address);
+extern uint32_t FindCallSite(const uint32_t return_address);
+extern uint32_t HashCallSite(const uint32_t return_address, const uint32_t seed, const uint32_t range);
+extern exidxEntry_t GetExidxEntry(const uint32_t section, const uint32_t offset);
+extern uint32_t DecodePrel31(const uint32_t word, const uint32_t where);
+extern uint32_t GetWord(const uint32_t section, const uint32_t offset);
 
 #endif /* STACKTRACE_H */
\ No newline at end of file
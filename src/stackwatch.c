@@ -0,0 +1,141 @@
+/**
+ * @file    stackwatch.c
+ * @author  Théo Bessel
+ * @brief   Interface for stack high-water mark monitoring
+ *
+ * The unused part of each watched stack is painted with STACK_PAINT : the main stack by
+ * Reset_Handler, the task stacks when they are added. The lowest word that is no longer
+ * painted is the deepest point the stack has reached (high-water mark).
+ *
+ * The scan is word-wise, from the bottom of the stack up to the current mark : a binary
+ * search would stop on the first painted word above the used part, such as an untouched
+ * local array, and overestimate the free space. PollStackWatch checks at most
+ * STACK_WATCH_SLICE words per call, so that it can run from the idle loop, and outputs the
+ * peak usage of a stack each time a pass finds it deeper.
+ *
+ * @copyright Copyright (c) Théo Bessel 2024
+ */
+
+/******************************* Include Files *******************************/
+
+#include "stackwatch.h"
+#include "fdir.h"
+#include "output.h"
+
+/*************************** Functions Declarations **************************/
+
+void PaintStack(uint32_t low);
+uint32_t AddStackWatch(stackBounds_t stack, uint8_t paint);
+void PollStackWatch(void);
+
+/*************************** Variables Definitions ***************************/
+
+/**
+ * @brief Contains the watched stacks
+ */
+stackWatchList_t stack_watch = {0};
+
+/*************************** Functions Definitions ***************************/
+
+/**
+ * @brief This function paints the stack it runs on, from `low` up to its own stack pointer
+ * @note Called by Reset_Handler before any other code uses the stack. Nothing below the
+ * stack pointer belongs to a frame, and the volatile stores keep the compiler from calling
+ * memset, whose frame would be painted over.
+ * @param[in] low                 The bottom of the stack
+ * @return Nothing
+ */
+void PaintStack(uint32_t low)
+{
+    uint32_t sp = 0;
+
+    __asm volatile ("mov %[sp], sp" : [sp] "=r" (sp));
+
+    for (volatile uint32_t* word = (uint32_t *) low; (uint32_t) word < sp; word++)
+    {
+        *word = STACK_PAINT;
+    }
+}
+
+/**
+ * @brief This function adds a stack to the watched ones
+ * @note The watch starts above the MPU guard of the stack, if it has been added before
+ * (see AddStackGuard) : scanning the guard would fault.
+ * @param[in] stack               The bounds of the stack
+ * @param[in] paint               Paint the whole stack first (not used yet, e.g. a task
+ * that has not started), otherwise it must already be painted
+ * @return The index of the watched stack, or STACK_WATCH_NONE if the list is full
+ */
+uint32_t AddStackWatch(stackBounds_t stack, uint8_t paint)
+{
+    stackWatch_t* watch = &stack_watch.stacks[stack_watch.count];
+
+    if (stack_watch.count >= STACK_WATCH_MAX)
+    {
+        return STACK_WATCH_NONE;
+    }
+
+    for (uint32_t guard = 0; guard < stack_guard_count; guard++)
+    {
+        if (stack_guards[guard].low - STACK_GUARD_SIZE >= stack.low && stack_guards[guard].low <= stack.high)
+        {
+            stack.low = stack_guards[guard].low;
+        }
+    }
+
+    if (paint)
+    {
+        for (volatile uint32_t* word = (uint32_t *) stack.low; (uint32_t) word < stack.high; word++)
+        {
+            *word = STACK_PAINT;
+        }
+    }
+
+    (*watch).stack = stack;
+    (*watch).mark = stack.high;
+    (*watch).cursor = stack.low;
+    (*watch).reported = stack.high;
+
+    return stack_watch.count++;
+}
+
+/**
+ * @brief This function scans the next slice of the watched stacks, to be called from the
+ * idle loop
+ * @note A pass ends on the first used word below the mark, or when the cursor reaches it :
+ * only the still painted words are read, STACK_WATCH_SLICE of them at most per call.
+ * @return Nothing
+ */
+void PollStackWatch(void)
+{
+    stackWatch_t* watch = &stack_watch.stacks[stack_watch.current];
+
+    if (stack_watch.count == 0)
+    {
+        return;
+    }
+
+    for (uint32_t word = 0; word < STACK_WATCH_SLICE && (*watch).cursor < (*watch).mark; word++)
+    {
+        if (*((volatile uint32_t *) (*watch).cursor) != STACK_PAINT)
+        {
+            (*watch).mark = (*watch).cursor;
+            break;
+        }
+
+        (*watch).cursor += 4;
+    }
+
+    if ((*watch).cursor >= (*watch).mark)
+    {
+        if ((*watch).mark != (*watch).reported)
+        {
+            (*watch).reported = (*watch).mark;
+            OutputStackUsage(stack_watch.current, (*watch).stack.high - (*watch).mark, (*watch).stack.high - (*watch).stack.low);
+        }
+
+        // Next pass, on the next stack
+        (*watch).cursor = (*watch).stack.low;
+        stack_watch.current = (stack_watch.current + 1) % stack_watch.count;
+    }
+}
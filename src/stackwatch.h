@@ -0,0 +1,58 @@
+/**
+ * @file    stackwatch.h
+ * @author  Théo Bessel
+ * @brief   Interface for stack high-water mark monitoring
+ *
+ * @copyright Copyright (c) Théo Bessel 2024
+ */
+
+#ifndef STACKWATCH_H
+#define STACKWATCH_H
+
+/******************************* Include Files *******************************/
+
+#include "tasktrace.h"
+
+/***************************** Macros Definitions ****************************/
+
+#define STACK_WATCH_MAX (TASK_TRACE_MAX_TASKS + 1u) /**< Main stack and the task stacks.  */
+#define STACK_WATCH_SLICE 32u           /**< Words checked per call of PollStackWatch.     */
+#define STACK_WATCH_NONE 0xffffffffu    /**< No room left to watch a stack.                */
+
+// Paint of the unused stack words, the byte FreeRTOS fills its task stacks with
+#define STACK_PAINT 0xa5a5a5a5u
+
+/***************************** Types Definitions *****************************/
+
+/**
+ * @brief Structure to store the high-water mark of a painted stack.
+ */
+typedef struct
+{
+    stackBounds_t stack;            /**< Watched (painted) part of the stack.*/
+    uint32_t mark;                  /**< Lowest word found used.             */
+    uint32_t cursor;                /**< Next word of the current pass.      */
+    uint32_t reported;              /**< Mark at the last report.            */
+} stackWatch_t;
+
+/**
+ * @brief Structure to store the watched stacks, scanned in turn.
+ */
+typedef struct
+{
+    uint32_t count;                             /**< Number of watched stacks. */
+    uint32_t current;                           /**< Stack being scanned.      */
+    stackWatch_t stacks[STACK_WATCH_MAX];       /**< Watched stacks.           */
+} stackWatchList_t;
+
+/*************************** Variables Declarations **************************/
+
+extern stackWatchList_t stack_watch;
+
+/*************************** Functions Declarations **************************/
+
+extern void PaintStack(uint32_t low);
+extern uint32_t AddStackWatch(stackBounds_t stack, uint8_t paint);
+extern void PollStackWatch(void);
+
+#endif /* STACKWATCH_H */
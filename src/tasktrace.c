@@ -0,0 +1,228 @@
+/**
+ * @file    tasktrace.c
+ * @author  Théo Bessel
+ * @brief   Interface for multi-task stack trace handling
+ *
+ * @copyright Copyright (c) Théo Bessel 2024
+ */
+
+/******************************* Include Files *******************************/
+
+#include "tasktrace.h"
+#include "fdir.h"
+
+/***************************** Macros Definitions ****************************/
+
+/**
+ * Saved context of a suspended task, as stacked by the FreeRTOS ARM_CM4F/ARM_CM7 ports
+ * (PendSV handler), from the saved PSP upwards :
+ *   - r4-r11 and EXC_RETURN, pushed by software
+ *   - S16-S31, pushed by software only if EXC_RETURN[4] = 0
+ *   - the exception frame, pushed by hardware
+ */
+#define TASK_CONTEXT_EXC_RETURN_OFFSET  (8 * 4)
+#define TASK_CONTEXT_SIZE               (9 * 4)
+#define TASK_CONTEXT_FPU_SIZE           (16 * 4)
+
+/*************************** Functions Declarations **************************/
+
+void UnwindAllTasks(const taskPort_t* port, const debugInfo_t* capture, taskSnapshot_t* snapshot);
+void UnwindTask(const taskInfo_t* task, callStack_t* call_stack);
+void UnwindRunningTask(const taskInfo_t* task, const debugInfo_t* capture, callStack_t* call_stack);
+void SetTaskPort(const taskPort_t* port);
+uint8_t GetRunningTaskStack(stackBounds_t* stack);
+
+/*************************** Variables Definitions ***************************/
+
+/**
+ * @brief RTOS port used by the fault handlers to find the stack of the running task (may be NULL)
+ */
+static const taskPort_t* task_port = 0;
+
+/*************************** Functions Definitions ***************************/
+
+/**
+ * @brief This function unwinds the stacks of all the tasks given by the port.
+ * @note The time spent per task is bounded by CALL_STACK_MAX_SIZE frames, and at most
+ * TASK_TRACE_MAX_TASKS tasks are unwound, so that it can run from a watchdog handler.
+ * @param[in] port              The RTOS port used to enumerate the tasks
+ * @param[in] capture           The state captured by the handler (fault or snapshot), from
+ * which the running task is unwound
+ * @param[out] snapshot         The structure where to store the call stacks
+ * @return Nothing
+ */
+void UnwindAllTasks(const taskPort_t* port, const debugInfo_t* capture, taskSnapshot_t* snapshot)
+{
+    uint32_t task_count = port->GetTaskCount();
+    taskInfo_t task = {0};
+
+    snapshot->size = 0;
+
+    if (task_count > TASK_TRACE_MAX_TASKS)
+    {
+        task_count = TASK_TRACE_MAX_TASKS;
+    }
+
+    for (uint32_t index = 0; index < task_count; index++)
+    {
+        if (!port->GetTask(index, &task))
+        {
+            continue;
+        }
+
+        snapshot->tasks[snapshot->size].id = task.id;
+
+        if (task.running)
+        {
+            UnwindRunningTask(&task, capture, &(snapshot->tasks[snapshot->size].call_stack));
+        }
+        else
+        {
+            UnwindTask(&task, &(snapshot->tasks[snapshot->size].call_stack));
+        }
+
+        snapshot->size += 1;
+    }
+}
+
+/**
+ * @brief This function unwinds the stack of a suspended task from its saved context.
+ * @param[in] task              The task to unwind
+ * @param[out] call_stack       The structure where to store the stracktrace
+ * @return Nothing
+ */
+void UnwindTask(const taskInfo_t* task, callStack_t* call_stack)
+{
+    stackBounds_t bounds = { .low = task->stack_start, .high = task->stack_end };
+    unwindRegisters_t task_registers = {0};
+    const savedRegisters_t* registers = 0;
+    uint32_t frame = task->psp + TASK_CONTEXT_SIZE;
+    uint32_t exc_return = 0x0;
+
+    call_stack->size = 0;
+
+    // The saved context must lie within the task stack, otherwise the task is not readable
+    if (task->psp < bounds.low || frame > bounds.high)
+    {
+        return;
+    }
+
+    exc_return = *((uint32_t *) (task->psp + TASK_CONTEXT_EXC_RETURN_OFFSET));
+
+    if (EXC_FRAME_HAS_FPU(exc_return))
+    {
+        frame += TASK_CONTEXT_FPU_SIZE;
+    }
+
+    if (frame + EXC_FRAME_BASIC_SIZE > bounds.high)
+    {
+        return;
+    }
+
+    // The task resumes at the stacked pc, with r4-r11 saved at the bottom of the software context
+    registers = (const savedRegisters_t *) frame;
+
+    for (uint32_t reg = 0; reg < 4; reg++)
+    {
+        task_registers.r[reg] = registers->r[reg];
+    }
+
+    for (uint32_t reg = 0; reg < 8; reg++)
+    {
+        task_registers.r[4 + reg] = *((uint32_t *) (task->psp + 4 * reg));
+    }
+
+    task_registers.r[12] = registers->r12;
+    task_registers.r[13] = EXC_FRAME_SP(frame, exc_return, registers->xpsr);
+    task_registers.r[14] = registers->lr;
+    task_registers.r[15] = registers->pc;
+
+    UnwindStackInBounds(call_stack, &task_registers, bounds);
+}
+
+/**
+ * @brief This function unwinds the stack of the running task, whose registers are live : the
+ * context saved in its stack is the one of its last switch, and the saved PSP is stale.
+ * @note If the handler interrupted the task (frame on PSP), the task is unwound from the
+ * captured registers, as the fault itself. If it interrupted another handler, the task was
+ * preempted earlier and only its exception frame is known, at the current PSP : the walk
+ * starts from its pc and lr, assuming a basic frame, without the callee-saved registers.
+ * @param[in] task              The running task
+ * @param[in] capture           The state captured by the handler (fault or snapshot)
+ * @param[out] call_stack       The structure where to store the stracktrace
+ * @return Nothing
+ */
+void UnwindRunningTask(const taskInfo_t* task, const debugInfo_t* capture, callStack_t* call_stack)
+{
+    stackBounds_t bounds = { .low = task->stack_start, .high = task->stack_end };
+    unwindRegisters_t task_registers = {0};
+    const savedRegisters_t* registers = (const savedRegisters_t *) capture->core.psp;
+
+    call_stack->size = 0;
+
+    if (capture->core.exc_return & EXC_RETURN_SPSEL_Msk)
+    {
+        GetUnwindRegisters(capture, &task_registers);
+    }
+    else
+    {
+        // The exception frame of the task must lie within its stack
+        if (capture->core.psp < bounds.low || capture->core.psp + EXC_FRAME_BASIC_SIZE > bounds.high)
+        {
+            return;
+        }
+
+        for (uint32_t reg = 0; reg < 4; reg++)
+        {
+            task_registers.r[reg] = registers->r[reg];
+        }
+
+        task_registers.r[12] = registers->r12;
+        task_registers.r[13] = EXC_FRAME_SP(capture->core.psp, EXC_RETURN_FTYPE_Msk, registers->xpsr);
+        task_registers.r[14] = registers->lr;
+        task_registers.r[15] = registers->pc;
+    }
+
+    UnwindStackInBounds(call_stack, &task_registers, bounds);
+}
+
+/**
+ * @brief This function sets the RTOS port used by the fault and snapshot handlers to bound the
+ * unwind of a context running on PSP to the stack of the running task.
+ * @param[in] port              The RTOS port, 0 to disable
+ * @return Nothing
+ */
+void SetTaskPort(const taskPort_t* port)
+{
+    task_port = port;
+}
+
+/**
+ * @brief This function gives the stack of the running task, as flagged by the port.
+ * @param[out] stack            The bounds of the stack of the running task
+ * @return 1 if the running task has been found, 0 otherwise (no port, or no running task)
+ */
+uint8_t GetRunningTaskStack(stackBounds_t* stack)
+{
+    uint32_t task_count = 0;
+    taskInfo_t task = {0};
+
+    if (task_port == 0)
+    {
+        return 0;
+    }
+
+    task_count = task_port->GetTaskCount();
+
+    for (uint32_t index = 0; index < task_count && index < TASK_TRACE_MAX_TASKS; index++)
+    {
+        if (task_port->GetTask(index, &task) && task.running)
+        {
+            stack->low = task.stack_start;
+            stack->high = task.stack_end;
+            return 1;
+        }
+    }
+
+    return 0;
+}
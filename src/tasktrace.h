@@ -0,0 +1,71 @@
+/**
+ * @file    tasktrace.h
+ * @author  Théo Bessel
+ * @brief   Interface for multi-task stack trace handling
+ *
+ * @copyright Copyright (c) Théo Bessel 2024
+ */
+
+#ifndef TASKTRACE_H
+#define TASKTRACE_H
+
+/******************************* Include Files *******************************/
+
+#include "fdir.h"
+
+/***************************** Macros Definitions ****************************/
+
+#define TASK_TRACE_MAX_TASKS 8u
+
+/***************************** Types Definitions *****************************/
+
+/**
+ * @brief Structure to describe a task as seen by the RTOS port.
+ */
+typedef struct
+{
+    uint32_t id;                    /**< Port defined identifier (e.g. TCB). */
+    uint32_t psp;                   /**< Saved process stack pointer.        */
+    uint32_t stack_start;           /**< Lowest address of the task stack.   */
+    uint32_t stack_end;             /**< Highest address of the stack (excl).*/
+    uint8_t running;                /**< Running task, `psp` is not up to date. */
+} taskInfo_t;
+
+/**
+ * @brief Callbacks to implement by the RTOS port to enumerate its tasks.
+ * @note They are called from an exception handler, they must not block nor
+ * take any RTOS lock.
+ */
+typedef struct
+{
+    uint32_t (*GetTaskCount)(void);                         /**< Number of tasks.             */
+    uint8_t (*GetTask)(uint32_t index, taskInfo_t* task);   /**< Fills `task`, 0 on failure.  */
+} taskPort_t;
+
+/**
+ * @brief Structure to store the call stack of a single task.
+ */
+typedef struct
+{
+    uint32_t id;                    /**< Port defined identifier (e.g. TCB). */
+    callStack_t call_stack;         /**< Captured call stack.                */
+} taskTrace_t;
+
+/**
+ * @brief Structure to store the call stacks of all the tasks.
+ */
+typedef struct
+{
+    uint32_t size;                              /**< Number of valid tasks.  */
+    taskTrace_t tasks[TASK_TRACE_MAX_TASKS];    /**< Captured task traces.   */
+} taskSnapshot_t;
+
+/*************************** Functions Declarations **************************/
+
+extern void UnwindAllTasks(const taskPort_t* port, const debugInfo_t* capture, taskSnapshot_t* snapshot);
+extern void UnwindTask(const taskInfo_t* task, callStack_t* call_stack);
+extern void UnwindRunningTask(const taskInfo_t* task, const debugInfo_t* capture, callStack_t* call_stack);
+extern void SetTaskPort(const taskPort_t* port);
+extern uint8_t GetRunningTaskStack(stackBounds_t* stack);
+
+#endif /* TASKTRACE_H */
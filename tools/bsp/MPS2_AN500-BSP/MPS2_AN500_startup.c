@@ -21,6 +21,11 @@
  */
 extern int main(void);
 
+/**
+ * @brief Paints the unused part of the main stack (see stackwatch.c)
+ */
+extern void PaintStack(uint32_t low);
+
 /**
  * @brief System Initialisation
  */
@@ -36,10 +41,7 @@ void Default_Handler(void);
  */
  void Reset_Handler(void);
  void NMI_Handler(void)             __attribute__ ((alias("Default_Handler")));
- extern void HardFault_Handler(void);
- extern void MemManage_Handler(void);
- extern void BusFault_Handler(void);
- extern void UsageFault_Handler(void);
+ extern void Fault_Handler(void);
  void SVCall_Handler(void)          __attribute__ ((alias("Default_Handler")));
  void DebugMonitor_Handler(void)    __attribute__ ((alias("Default_Handler")));
  void PendSV_Handler(void)          __attribute__ ((alias("Default_Handler")));
@@ -48,6 +50,7 @@ void Default_Handler(void);
 /*************************** Variables Definitions ***************************/
 
 extern uint32_t __stack_end__;
+extern uint32_t __stack_limit__;
 extern uint32_t __bss_start__;
 extern uint32_t __bss_end__;
 
@@ -58,10 +61,10 @@ uint32_t isr_vectors[] __attribute__((section(".isr_vector"))) = {
   (uint32_t) &__stack_end__,
   (uint32_t) &Reset_Handler,
   (uint32_t) &NMI_Handler,
-  (uint32_t) &HardFault_Handler,
-  (uint32_t) &MemManage_Handler,
-  (uint32_t) &BusFault_Handler,
-  (uint32_t) &UsageFault_Handler,
+  (uint32_t) &Fault_Handler,        // HardFault
+  (uint32_t) &Fault_Handler,        // MemManage
+  (uint32_t) &Fault_Handler,        // BusFault
+  (uint32_t) &Fault_Handler,        // UsageFault
   0,
   0,
   0,
@@ -82,6 +85,9 @@ void Reset_Handler(void) {
   // Initialisation of the system
   // SystemInit();
 
+  // Paint the main stack below the frame of Reset_Handler, for its high-water mark
+  PaintStack((uint32_t) &__stack_limit__);
+
   // Variable Initialisation
   uint32_t bss_size = (uint32_t) &__bss_end__ - (uint32_t) &__bss_start__;
   uint8_t *bss_ptr = (uint8_t *) &__bss_start__;
@@ -0,0 +1,59 @@
+/**
+ * @file    MPS2_AN500_uart.c
+ * @author  Théo Bessel
+ * @brief   Polled UART driver for MPS2-AN500 (CMSDK APB UART)
+ *
+ * @copyright Copyright (c) Théo Bessel 2024
+ */
+
+/******************************* Include Files *******************************/
+
+#include "MPS2_AN500_uart.h"
+
+/***************************** Macros Definitions ****************************/
+
+/**
+ * @brief UART0 registers, connected to `-serial` by QEMU
+ *
+ * Referencing : DAI0500B_cortex_m7_on_v2m_mps2.pdf, CMSDK APB UART
+ */
+#define UART0_BASE              0x40004000
+#define UART0_DATA              (*((volatile uint32_t *) (UART0_BASE + 0x00)))
+#define UART0_STATE             (*((volatile uint32_t *) (UART0_BASE + 0x04)))
+#define UART0_CTRL              (*((volatile uint32_t *) (UART0_BASE + 0x08)))
+#define UART0_BAUDDIV           (*((volatile uint32_t *) (UART0_BASE + 0x10)))
+
+#define UART_STATE_TX_FULL_Msk  (1 << 0)
+#define UART_CTRL_TX_EN_Msk     (1 << 0)
+
+// Minimal divider accepted by the UART (the baudrate is not modeled by QEMU)
+#define UART_BAUDDIV_MIN        16
+
+/*************************** Functions Definitions ***************************/
+
+/**
+ * @brief This function enables the transmitter of UART0
+ * @return Nothing
+ */
+void UART_Init(void)
+{
+    UART0_BAUDDIV = UART_BAUDDIV_MIN;
+    UART0_CTRL |= UART_CTRL_TX_EN_Msk;
+}
+
+/**
+ * @brief This function writes a byte to UART0 if the transmitter can take it, it never waits
+ * @param[in] byte                The byte to send
+ * @return 1 if the byte has been written, 0 if the transmitter is full
+ */
+uint8_t UART_TryPutc(uint8_t byte)
+{
+    if (UART0_STATE & UART_STATE_TX_FULL_Msk)
+    {
+        return 0;
+    }
+
+    UART0_DATA = byte;
+
+    return 1;
+}
@@ -0,0 +1,21 @@
+/**
+ * @file    MPS2_AN500_uart.h
+ * @author  Théo Bessel
+ * @brief   Polled UART driver for MPS2-AN500 (CMSDK APB UART)
+ *
+ * @copyright Copyright (c) Théo Bessel 2024
+ */
+
+#ifndef MPS2_AN500_UART_H
+#define MPS2_AN500_UART_H
+
+/******************************* Include Files *******************************/
+
+#include <stdint.h>
+
+/*************************** Functions Declarations **************************/
+
+extern void UART_Init(void);
+extern uint8_t UART_TryPutc(uint8_t byte);
+
+#endif /* MPS2_AN500_UART_H */
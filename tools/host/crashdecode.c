@@ -0,0 +1,137 @@
+/**
+ * @file    crashdecode.c
+ * @author  Théo Bessel
+ * @brief   Host decoder for compact crash records
+ *
+ * Usage : crashdecode <records.bin> [<target.elf>]
+ *
+ * The file holds any number of concatenated crash and stack usage records (see record.c), as
+ * output in binary format (OUTPUT_FORMAT_BINARY). It is read at once
+ * and decoded in a single pass, so decoding is bound by memory bandwidth. Records only
+ * hold raw addresses : when the ELF file of the target is given, the function start and
+ * the symbol of each frame are resolved from its unwind table and symbol table.
+ *
+ * @copyright Copyright (c) Théo Bessel 2024
+ */
+
+/******************************* Include Files *******************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "record.h"
+#include "image.h"
+
+/*************************** Functions Declarations **************************/
+
+void PrintRecord(uint32_t index, debugInfo_t* debug_info, const image_t* image);
+
+/*************************** Functions Definitions ***************************/
+
+int main(int argc, char** argv)
+{
+    debugInfo_t debug_info = {0};
+    image_t image = {0};
+    uint32_t size = 0;
+    uint32_t offset = 0;
+    uint32_t length = 0;
+    uint32_t count = 0;
+    uint32_t stack = 0;
+    uint32_t peak = 0;
+    uint32_t stack_size = 0;
+    uint8_t* buffer = NULL;
+
+    if (argc != 2 && argc != 3)
+    {
+        fprintf(stderr, "Usage: %s <records.bin> [<target.elf>]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (argc == 3)
+    {
+        if (LoadImage(&image, argv[2]) != 0)
+        {
+            return EXIT_FAILURE;
+        }
+
+        SetHostImage(&image);
+    }
+
+    buffer = ReadFile(argv[1], &size);
+    if (buffer == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+
+    while (offset < size)
+    {
+        length = DecodeStackUsageRecord(buffer + offset, size - offset, &stack, &peak, &stack_size);
+
+        if (length != 0)
+        {
+            printf("Stack %u peak %u / %u bytes\n", stack, peak, stack_size);
+            offset += length;
+            continue;
+        }
+
+        length = DecodeCrashRecord(buffer + offset, size - offset, &debug_info);
+
+        if (length == 0)
+        {
+            // Resynchronize on the next byte after a corrupted record
+            fprintf(stderr, "Invalid record at offset %u\n", offset);
+            offset += 1;
+            continue;
+        }
+
+        PrintRecord(count++, &debug_info, argc == 3 ? &image : NULL);
+        offset += length;
+    }
+
+    free(buffer);
+    FreeImage(&image);
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief This function prints a decoded record.
+ * @param[in] index               The index of the record in the file
+ * @param[in,out] debug_info      The decoded record, its function starts are resolved
+ * @param[in] image               The image of the target, NULL to print raw addresses
+ * @return Nothing
+ */
+void PrintRecord(uint32_t index, debugInfo_t* debug_info, const image_t* image)
+{
+    uint32_t offset = 0;
+    const char* name = NULL;
+
+    printf("Record %u (exception %u, EXC_RETURN 0x%08x)\n", index, debug_info->exception, debug_info->core.exc_return);
+    printf("  r0   0x%08x  r1   0x%08x  r2   0x%08x  r3   0x%08x\n",
+        debug_info->registers.r[0], debug_info->registers.r[1], debug_info->registers.r[2], debug_info->registers.r[3]);
+    printf("  r12  0x%08x  lr   0x%08x  pc   0x%08x  xpsr 0x%08x\n",
+        debug_info->registers.r12, debug_info->registers.lr, debug_info->registers.pc, debug_info->registers.xpsr);
+    printf("  cfsr 0x%08x  hfsr 0x%08x\n", debug_info->cfsr, debug_info->hfsr);
+    if (debug_info->stack_guard != STACK_GUARD_NONE)
+    {
+        printf("  stack overflow : MPU guard %u hit\n", debug_info->stack_guard);
+    }
+
+    if (image == NULL)
+    {
+        for (uint32_t frame = 0; frame < debug_info->call_stack.size; frame++)
+        {
+            printf("  #%-2u 0x%08x\n", frame, debug_info->call_stack.calls[frame].pc);
+        }
+
+        return;
+    }
+
+    ResolveCallStack(&debug_info->call_stack);
+
+    for (uint32_t frame = 0; frame < debug_info->call_stack.size; frame++)
+    {
+        name = FindSymbol(image, debug_info->call_stack.calls[frame].pc, &offset);
+        printf("  #%-2u 0x%08x  in 0x%08x  %s+0x%x\n", frame, debug_info->call_stack.calls[frame].pc,
+            debug_info->call_stack.calls[frame].fn, name ? name : "??", offset);
+    }
+}
@@ -0,0 +1,241 @@
+/**
+ * @file    dumpunwind.c
+ * @author  Théo Bessel
+ * @brief   Offline unwinder for semihosting dumps
+ *
+ * Usage : dumpunwind <target.elf> <fdir_dump.bin>
+ *
+ * Unwinds the dumped stack window again on host with the target unwinder, using the
+ * unwind tables of the ELF, and compares the result with the call stack computed on
+ * target. When the dump holds a reference call stack (libgcc `_Unwind_Backtrace`, scenario 4
+ * of main.c), it is compared with the one of the target too : the first frame of libgcc is
+ * the call site of `_Unwind_Backtrace`, so only its function must match, the other frames
+ * must have the same return address, and the target may only have more frames whose function
+ * cannot be unwound (libgcc stops before reporting them). The exit status is 0 if all the
+ * call stacks match, 1 otherwise. Dumps of lazy builds (CALL_STACK_RESOLVE_FN set to 0), whose
+ * frames have no function start, are read too.
+ *
+ * @copyright Copyright (c) Théo Bessel 2024
+ */
+
+/******************************* Include Files *******************************/
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "output.h"
+#include "image.h"
+
+/***************************** Macros Definitions ****************************/
+
+// CantUnwind symbol
+#define EXIDX_CANTUNWIND 0x1
+
+// Size of a dumped call stack, from the size of its frames
+#define DUMP_CALL_STACK_SIZE(call_size) (4 + CALL_STACK_MAX_SIZE * (call_size))
+
+/*************************** Functions Declarations **************************/
+
+void ReadCallStack(callStack_t* call_stack, const uint8_t* data, uint32_t call_size);
+void PrintCallStack(const image_t* image, const char* title, const callStack_t* call_stack);
+uint8_t CompareReference(const callStack_t* reference, const callStack_t* call_stack);
+
+/*************************** Functions Definitions ***************************/
+
+int main(int argc, char** argv)
+{
+    image_t image = {0};
+    dumpHeader_t header = {0};
+    debugInfo_t debug_info = {0};
+    callStack_t call_stack = {0};
+    callStack_t reference = {0};
+    unwindRegisters_t registers = {0};
+    stackBounds_t bounds = {0};
+    uint8_t* dump = NULL;
+    uint32_t size = 0;
+    int status = EXIT_SUCCESS;
+
+    if (argc != 3)
+    {
+        fprintf(stderr, "Usage: %s <target.elf> <fdir_dump.bin>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (LoadImage(&image, argv[1]) != 0 || (dump = ReadFile(argv[2], &size)) == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+
+    memcpy(&header, dump, size < sizeof(header) ? size : sizeof(header));
+
+    // Frames hold a function start, unless the target was built in lazy mode
+    if (
+        header.magic != OUTPUT_DUMP_MAGIC
+        || header.version != OUTPUT_DUMP_VERSION
+        || (header.call_size != sizeof(call_t) && header.call_size != sizeof(call_t) - 4)
+        || header.info_size != offsetof(debugInfo_t, call_stack) + DUMP_CALL_STACK_SIZE(header.call_size)
+        || (header.reference_size != 0 && header.reference_size != DUMP_CALL_STACK_SIZE(header.call_size))
+        || size < sizeof(header) + header.info_size + header.stack_size + header.reference_size
+    )
+    {
+        fprintf(stderr, "%s: invalid or truncated dump\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    memcpy(&debug_info, dump + sizeof(header), offsetof(debugInfo_t, call_stack));
+    ReadCallStack(&debug_info.call_stack, dump + sizeof(header) + offsetof(debugInfo_t, call_stack), header.call_size);
+    if (header.reference_size != 0)
+    {
+        ReadCallStack(&reference, dump + sizeof(header) + header.info_size + header.stack_size, header.call_size);
+    }
+
+    // The dumped stack hides the content of the ELF at the same addresses
+    AddSegment(&image, header.stack_start, header.stack_size, dump + sizeof(header) + header.info_size);
+    SetHostImage(&image);
+
+    printf("Exception %u at pc 0x%08x (cfsr 0x%08x, hfsr 0x%08x), dumped at %u.%02u s\n",
+        debug_info.exception, debug_info.registers.pc, debug_info.cfsr, debug_info.hfsr,
+        header.clock / 100, header.clock % 100);
+    printf("Interrupted sp 0x%08x (msp 0x%08x, psp 0x%08x), r4-r11", debug_info.sp, debug_info.core.msp, debug_info.core.psp);
+    for (uint32_t reg = 0; reg < 8; reg++)
+    {
+        printf(" 0x%08x", debug_info.core.r[reg]);
+    }
+    printf("\n");
+    if (debug_info.stack_guard != STACK_GUARD_NONE)
+    {
+        printf("Stack overflow : MPU guard %u hit\n", debug_info.stack_guard);
+    }
+    printf("Unwound on target in %u cycles (fault entry %u cycles)\n", debug_info.unwind_cycles, debug_info.capture_cycles);
+
+    // Same unwind base context as HandleFault (see GetUnwindRegisters) : the interrupted registers
+    for (uint32_t reg = 0; reg < 4; reg++)
+    {
+        registers.r[reg] = debug_info.registers.r[reg];
+    }
+    for (uint32_t reg = 0; reg < 8; reg++)
+    {
+        registers.r[4 + reg] = debug_info.core.r[reg];
+    }
+    registers.r[12] = debug_info.registers.r12;
+    registers.r[13] = debug_info.sp;
+    registers.r[14] = debug_info.registers.lr;
+    registers.r[15] = debug_info.registers.pc;
+    bounds.low = header.stack_start;
+    bounds.high = header.stack_start + header.stack_size;
+    UnwindStackInBounds(&call_stack, &registers, bounds);
+
+    // The target may have left the function starts to the host
+    ResolveCallStack(&debug_info.call_stack);
+    ResolveCallStack(&call_stack);
+
+    PrintCallStack(&image, "Target", &debug_info.call_stack);
+    PrintCallStack(&image, "Host", &call_stack);
+
+    if (
+        call_stack.size != debug_info.call_stack.size
+        || memcmp(call_stack.calls, debug_info.call_stack.calls, call_stack.size * sizeof(call_t)) != 0
+    )
+    {
+        printf("Call stacks differ\n");
+        status = EXIT_FAILURE;
+    }
+
+    if (header.reference_size != 0)
+    {
+        ResolveCallStack(&reference);
+        PrintCallStack(&image, "libgcc", &reference);
+
+        if (CompareReference(&reference, &debug_info.call_stack) != 0)
+        {
+            printf("libgcc call stack differs\n");
+            status = EXIT_FAILURE;
+        }
+    }
+
+    free(dump);
+    FreeImage(&image);
+
+    return status;
+}
+
+/**
+ * @brief This function reads a dumped call stack, keeping the pc and the sp of its frames.
+ * @param[out] call_stack         The call stack, function starts left to ResolveCallStack
+ * @param[in] data                The dumped call stack
+ * @param[in] call_size           The size of the dumped frames (the sp is their last word)
+ * @return Nothing
+ */
+void ReadCallStack(callStack_t* call_stack, const uint8_t* data, uint32_t call_size)
+{
+    memcpy(&call_stack->size, data, sizeof(call_stack->size));
+
+    for (uint32_t frame = 0; frame < CALL_STACK_MAX_SIZE; frame++)
+    {
+        memcpy(&call_stack->calls[frame].pc, data + 4 + frame * call_size, 4);
+        memcpy(&call_stack->calls[frame].sp, data + 4 + frame * call_size + call_size - 4, 4);
+        call_stack->calls[frame].fn = 0;
+    }
+}
+
+/**
+ * @brief This function prints a call stack with symbol names.
+ * @param[in] image               The image holding the symbols
+ * @param[in] title               The title of the call stack
+ * @param[in] call_stack          The call stack
+ * @return Nothing
+ */
+void PrintCallStack(const image_t* image, const char* title, const callStack_t* call_stack)
+{
+    uint32_t offset = 0;
+    const char* name = NULL;
+
+    printf("%s call stack (%u frames)\n", title, call_stack->size);
+
+    for (uint32_t frame = 0; frame < call_stack->size && frame < CALL_STACK_MAX_SIZE; frame++)
+    {
+        name = FindSymbol(image, call_stack->calls[frame].pc, &offset);
+        printf("  #%-2u 0x%08x  %s+0x%x\n", frame, call_stack->calls[frame].pc, name ? name : "??", offset);
+    }
+}
+
+/**
+ * @brief This function compares the call stack of the target with a reference call stack
+ * unwound by libgcc from the same function.
+ * @param[in] reference           The reference call stack, with its function starts resolved
+ * @param[in] call_stack          The call stack of the target, with its function starts resolved
+ * @return 0 if the call stacks match, 1 otherwise
+ */
+uint8_t CompareReference(const callStack_t* reference, const callStack_t* call_stack)
+{
+    if (reference->size == 0 || reference->size > call_stack->size || call_stack->size > CALL_STACK_MAX_SIZE)
+    {
+        return 1;
+    }
+
+    // The reference starts from the call site of `_Unwind_Backtrace`, not from the faulting pc
+    if (reference->calls[0].fn != call_stack->calls[0].fn)
+    {
+        return 1;
+    }
+
+    for (uint32_t frame = 1; frame < reference->size; frame++)
+    {
+        if (reference->calls[frame].pc != call_stack->calls[frame].pc)
+        {
+            return 1;
+        }
+    }
+
+    // libgcc does not report the frames without unwind entry or marked EXIDX_CANTUNWIND
+    for (uint32_t frame = reference->size; frame < call_stack->size; frame++)
+    {
+        if (FindExidxEntry(call_stack->calls[frame].pc - 1).exidx_entry != EXIDX_CANTUNWIND)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,852 @@
+/**
+ * @file    exidxdump.c
+ * @author  Théo Bessel
+ * @brief   Dump of the unwind tables as decoded by the target unwinder
+ *
+ * Usage : exidxdump <target.elf> [--bench <iterations>]
+ *         exidxdump --opcodes
+ *         exidxdump --chain
+ *
+ * Prints every `.ARM.exidx` entry with the unwind instructions fetched by GetInstruction,
+ * using the same layout as `readelf -u` so that both outputs can be compared line by line
+ * (see `make exidx-diff`). With `--bench`, every entry is decoded again the given number
+ * of times with GetExidxEntry and DecodeFrame and the decode throughput is reported.
+ * With `--opcodes`, a table entry is generated for every form of unwinding instruction and
+ * decoded by DecodeFrame on a synthetic stack, the resulting register set being compared with
+ * the one of a reference decoder written from the EHABI opcode table. With `--chain`, a
+ * synthetic unwind table and stack are unwound by UnwindStackInBounds from an interrupted
+ * context : a leaf first frame, a frame that does not use r7, and a first frame interrupted
+ * before its prologue.
+ *
+ * @copyright Copyright (c) Théo Bessel 2024
+ */
+
+/******************************* Include Files *******************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stacktrace.h"
+#include "image.h"
+
+/***************************** Macros Definitions ****************************/
+
+// CantUnwind symbol
+#define EXIDX_CANTUNWIND 0x1
+
+// Synthetic memory of the opcode forms (unmapped on the MPS2), and number of instructions of their entry
+#define OPCODES_STACK 0xd0000000u
+#define OPCODES_STACK_WORDS 256u
+#define OPCODES_ENTRY 0xd1000000u
+#define OPCODES_COUNT 6u
+
+/**
+ * Synthetic functions of the chain, each one covering 0x100 bytes of code :
+ *   - CHAIN_LEAF : leaf, pushes nothing (`finish`)
+ *   - CHAIN_NO_FP : `push {r4, lr}; sub sp, #8`, without frame pointer
+ *   - CHAIN_FP : `push {r7, lr}; mov r7, sp`
+ *   - CHAIN_ROOT : EXIDX_CANTUNWIND, ends the walk
+ */
+#define CHAIN_LEAF 0x1000u
+#define CHAIN_NO_FP 0x1100u
+#define CHAIN_FP 0x1200u
+#define CHAIN_ROOT 0x1300u
+#define CHAIN_EXIDX 0xd2000000u
+#define CHAIN_STACK 0xd3000000u
+#define CHAIN_STACK_WORDS 16u
+
+/*************************** Functions Declarations **************************/
+
+void DumpEntry(const image_t* image, uint32_t index);
+void DumpInstructions(uint32_t entry_ptr, uint32_t entry);
+void DumpOpcodes(uint32_t entry_ptr, uint32_t word, uint32_t count, uint32_t offset);
+uint32_t PrintInstruction(const uint8_t* instructions, uint32_t count);
+void PrintRegisterList(const char* prefix, uint32_t mask, uint32_t first);
+void Benchmark(const image_t* image, uint32_t iterations);
+uint32_t CheckOpcodes(image_t* image);
+uint32_t CheckProgram(const uint8_t* opcodes, uint32_t length, uint32_t tail);
+uint32_t ReferenceDecode(const uint8_t* program, uint32_t count, unwindRegisters_t* vrs);
+uint32_t ReferencePop(unwindRegisters_t* vrs, uint32_t mask);
+uint32_t IsTwoByteOpcode(uint8_t op);
+uint32_t CheckChain(image_t* image);
+uint32_t CheckCallStack(const char* title, const unwindRegisters_t* registers, const call_t* expected, uint32_t count);
+
+/*************************** Variables Definitions ***************************/
+
+/**
+ * @brief Synthetic stack and table entry of the opcode forms (little endian words)
+ */
+static uint32_t opcodes_stack[OPCODES_STACK_WORDS] = {0};
+static uint32_t opcodes_entry[2] = {0};
+
+/**
+ * @brief Synthetic unwind table and stack of the chain (little endian words)
+ */
+static uint32_t chain_exidx[8] = {0};
+static uint32_t chain_stack[CHAIN_STACK_WORDS] = {0};
+
+/*************************** Functions Definitions ***************************/
+
+int main(int argc, char** argv)
+{
+    image_t image = {0};
+    uint32_t entries_count = 0;
+
+    if (argc == 2 && strcmp(argv[1], "--opcodes") == 0)
+    {
+        return CheckOpcodes(&image) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (argc == 2 && strcmp(argv[1], "--chain") == 0)
+    {
+        return CheckChain(&image) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (argc != 2 && !(argc == 4 && strcmp(argv[2], "--bench") == 0))
+    {
+        fprintf(stderr, "Usage: %s <target.elf> [--bench <iterations>]\n", argv[0]);
+        fprintf(stderr, "       %s --opcodes\n", argv[0]);
+        fprintf(stderr, "       %s --chain\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (LoadImage(&image, argv[1]) != 0)
+    {
+        return EXIT_FAILURE;
+    }
+
+    SetHostImage(&image);
+    entries_count = (image.exidx_end - image.exidx_start) / 8;
+
+    if (argc == 4)
+    {
+        Benchmark(&image, strtoul(argv[3], NULL, 0));
+    }
+    else
+    {
+        printf("Unwind section '.ARM.exidx' contains %u entries:\n", entries_count);
+
+        for (uint32_t index = 0; index < entries_count; index++)
+        {
+            DumpEntry(&image, index);
+        }
+    }
+
+    FreeImage(&image);
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief This function prints an exidx entry and its unwind instructions.
+ * @param[in] image               The image holding the symbols
+ * @param[in] index               The index of the entry
+ * @return Nothing
+ */
+void DumpEntry(const image_t* image, uint32_t index)
+{
+    exidxEntry_t entry = GetExidxEntry(image->exidx_start, 8 * index);
+    const char* name = FindSymbol(image, entry.decoded_fn, NULL);
+    uint32_t extab_entry = 0x0;
+    uint32_t personality = 0x0;
+
+    printf("\n0x%x <%s>: ", entry.decoded_fn, name ? name : "??");
+
+    if (entry.exidx_entry == EXIDX_CANTUNWIND)
+    {
+        printf("0x1 [cantunwind]\n");
+    }
+    else if (entry.exidx_entry & 0x80000000)
+    {
+        printf("0x%x\n", entry.exidx_entry);
+        DumpInstructions(entry.decoded_entry, entry.exidx_entry);
+    }
+    else
+    {
+        extab_entry = GetWord(entry.decoded_entry, 0);
+        printf("@0x%x\n", entry.decoded_entry);
+
+        if (extab_entry & 0x80000000)
+        {
+            DumpInstructions(entry.decoded_entry, extab_entry);
+        }
+        else
+        {
+            personality = DecodePrel31(extab_entry, entry.decoded_entry);
+            name = FindSymbol(image, personality, NULL);
+            printf("  Personality routine: 0x%x <%s>\n", personality, name ? name : "??");
+
+            extab_entry = GetWord(entry.decoded_entry, 4);
+            DumpOpcodes(entry.decoded_entry + 4, extab_entry, 3 + 4 * (extab_entry >> 24), 1);
+        }
+    }
+}
+
+/**
+ * @brief This function fetches the unwind instructions of a compact model entry exactly
+ * as DecodeFrame does, and prints them.
+ * @param[in] entry_ptr           The address of the entry words
+ * @param[in] entry               The first word of the entry
+ * @return Nothing
+ */
+void DumpInstructions(uint32_t entry_ptr, uint32_t entry)
+{
+    uint32_t index = (entry >> 24) & 0xf;
+    uint32_t word = entry & 0xffffff;
+    uint32_t count = 0;
+    uint32_t offset = 0;
+
+    printf("  Compact model index: %u\n", index);
+
+    switch (index)
+    {
+        case 0:
+            count = 3;
+            offset = 1;
+            break;
+        case 1:
+        case 2:
+            count = 2 + 4 * ((word >> 16) & 0xff);
+            offset = 2;
+            break;
+        default:
+            printf("  [reserved compact index %u]\n", index);
+            return;
+    }
+
+    DumpOpcodes(entry_ptr, word, count, offset);
+}
+
+/**
+ * @brief This function fetches and prints a sequence of unwind instructions.
+ * @param[in] entry_ptr           The address of the words holding the instructions
+ * @param[in] word                The first word holding the instructions
+ * @param[in] count               The number of instructions
+ * @param[in] offset              The number of bytes of the first word before the instructions
+ * @return Nothing
+ */
+void DumpOpcodes(uint32_t entry_ptr, uint32_t word, uint32_t count, uint32_t offset)
+{
+    uint8_t instructions[3 + 4 * 255] = {0};
+
+    for (uint32_t instruction = 0; instruction < count; instruction++)
+    {
+        instructions[instruction] = GetInstruction(entry_ptr, word, instruction, offset);
+    }
+
+    for (uint32_t instruction = 0; instruction < count; )
+    {
+        instruction += PrintInstruction(instructions + instruction, count - instruction);
+    }
+}
+
+/**
+ * @brief This function prints an unwind instruction like `readelf -u` does.
+ * @param[in] instructions        The instructions, starting at the one to print
+ * @param[in] count               The number of available instructions
+ * @return The number of bytes of the instruction
+ */
+uint32_t PrintInstruction(const uint8_t* instructions, uint32_t count)
+{
+    uint8_t op = instructions[0];
+    uint8_t op2 = count > 1 ? instructions[1] : 0;
+    uint32_t length = 1;
+
+    printf("  0x%02x ", op);
+
+    if ((op & 0xc0) == 0x00)
+    {
+        printf("     vsp = vsp + %d", ((op & 0x3f) << 2) + 4);
+    }
+    else if ((op & 0xc0) == 0x40)
+    {
+        printf("     vsp = vsp - %d", ((op & 0x3f) << 2) + 4);
+    }
+    else if ((op & 0xf0) == 0x80 && count > 1)
+    {
+        length = 2;
+        printf("0x%02x ", op2);
+        if (op == 0x80 && op2 == 0x00)
+        {
+            printf("Refuse to unwind");
+        }
+        else
+        {
+            PrintRegisterList("pop", ((op & 0x0f) << 8) | op2, 4);
+        }
+    }
+    else if ((op & 0xf0) == 0x90)
+    {
+        if (op == 0x9d || op == 0x9f)
+        {
+            printf("     [Reserved]");
+        }
+        else
+        {
+            printf("     vsp = r%d", op & 0x0f);
+        }
+    }
+    else if ((op & 0xf0) == 0xa0)
+    {
+        printf("     ");
+        PrintRegisterList("pop", (((1 << ((op & 0x07) + 1)) - 1)) | ((op & 0x08) ? (1 << 10) : 0), 4);
+    }
+    else if (op == 0xb0)
+    {
+        printf("     finish");
+    }
+    else if (op == 0xb1 && count > 1)
+    {
+        length = 2;
+        printf("0x%02x ", op2);
+        if (op2 == 0 || (op2 & 0xf0) != 0)
+        {
+            printf("[Spare]");
+        }
+        else
+        {
+            PrintRegisterList("pop", op2, 0);
+        }
+    }
+    else if (op == 0xb2 && count > 1)
+    {
+        uint32_t value = 0;
+        uint32_t shift = 0;
+
+        do {
+            printf("0x%02x ", instructions[length]);
+            value |= (instructions[length] & 0x7f) << shift;
+            shift += 7;
+        } while ((instructions[length++] & 0x80) && length < count && shift < 32);
+
+        printf("vsp = vsp + %u", 0x204 + (value << 2));
+    }
+    else if ((op == 0xb3 || op == 0xc8 || op == 0xc9) && count > 1)
+    {
+        length = 2;
+        printf("0x%02x ", op2);
+        printf("pop {D%d-D%d}", (op2 >> 4) + (op == 0xc8 ? 16 : 0), (op2 >> 4) + (op2 & 0x0f) + (op == 0xc8 ? 16 : 0));
+        if (op == 0xb3)
+        {
+            printf(" (FSTMFDX)");
+        }
+    }
+    else if ((op & 0xf8) == 0xb8 || (op & 0xf8) == 0xd0)
+    {
+        printf("     pop {D8-D%d}", 8 + (op & 0x07));
+        if ((op & 0xf8) == 0xb8)
+        {
+            printf(" (FSTMFDX)");
+        }
+    }
+    else if ((op & 0xf8) == 0xc0 && op != 0xc6 && op != 0xc7)
+    {
+        printf("     pop {wR10-wR%d}", 10 + (op & 0x07));
+    }
+    else if (op == 0xc6 && count > 1)
+    {
+        length = 2;
+        printf("0x%02x pop {wR%d-wR%d}", op2, op2 >> 4, (op2 >> 4) + (op2 & 0x0f));
+    }
+    else if (op == 0xc7 && count > 1)
+    {
+        length = 2;
+        printf("0x%02x ", op2);
+        if (op2 == 0 || (op2 & 0xf0) != 0)
+        {
+            printf("[Spare]");
+        }
+        else
+        {
+            PrintRegisterList("pop", op2, 0);
+        }
+    }
+    else
+    {
+        printf("     [Spare]");
+    }
+
+    printf("\n");
+
+    return length;
+}
+
+/**
+ * @brief This function prints a register list like `pop {r4, r5, r14}`.
+ * @param[in] prefix              The mnemonic
+ * @param[in] mask                The register mask, bit 0 being the register `first`
+ * @param[in] first               The first register of the mask
+ * @return Nothing
+ */
+void PrintRegisterList(const char* prefix, uint32_t mask, uint32_t first)
+{
+    const char* separator = "";
+
+    printf("%s {", prefix);
+
+    for (uint32_t reg = 0; reg < 16; reg++)
+    {
+        if (mask & (1 << reg))
+        {
+            printf("%sr%u", separator, reg + first);
+            separator = ", ";
+        }
+    }
+
+    printf("}");
+}
+
+/**
+ * @brief This function measures the decode throughput of the unwinder.
+ * @param[in] image               The image to decode
+ * @param[in] iterations          The number of passes over the table
+ * @return Nothing
+ */
+void Benchmark(const image_t* image, uint32_t iterations)
+{
+    uint32_t entries_count = (image->exidx_end - image->exidx_start) / 8;
+    volatile uint32_t sink = 0;
+    unwindRegisters_t vrs = {0};
+    stackBounds_t bounds = { .low = 0x0, .high = 0xffffffff };
+    struct timespec start = {0};
+    struct timespec end = {0};
+    exidxEntry_t entry = {0};
+    double seconds = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (uint32_t iteration = 0; iteration < iterations; iteration++)
+    {
+        for (uint32_t index = 0; index < entries_count; index++)
+        {
+            entry = GetExidxEntry(image->exidx_start, 8 * index);
+            vrs = (unwindRegisters_t) {0};
+
+            if (entry.exidx_entry & 0x80000000)
+            {
+                sink += DecodeFrame(entry.exidx_entry, entry.decoded_entry, &vrs, bounds) + vrs.r[13];
+            }
+            else if (entry.exidx_entry != EXIDX_CANTUNWIND && (GetWord(entry.decoded_entry, 0) & 0x80000000))
+            {
+                sink += DecodeFrame(GetWord(entry.decoded_entry, 0), entry.decoded_entry, &vrs, bounds) + vrs.r[13];
+            }
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    printf("%u entries x %u iterations in %.3f s : %.0f entries/s\n",
+        entries_count, iterations, seconds, seconds > 0 ? entries_count * (double) iterations / seconds : 0.0);
+}
+
+/**
+ * @brief This function decodes every form of unwinding instruction with DecodeFrame and with the
+ * reference decoder : the forms are placed at the start of a Lu16 entry (followed by `finish`)
+ * and at its end (preceded by `vsp = vsp + 4`), so that truncated forms are covered too.
+ * @param[in,out] image           The image, receiving the synthetic stack and entry
+ * @return The number of forms decoded differently
+ */
+uint32_t CheckOpcodes(image_t* image)
+{
+    // Operands of the two byte forms (registers masks, VFP ranges, spare encodings)
+    static const uint8_t operands[] = { 0x00, 0x01, 0x08, 0x0f, 0x10, 0x35, 0x88, 0xf0, 0xff };
+
+    // ULEB128 operands of 10110010, the last one being truncated
+    static const uint8_t uleb128[][4] = {
+        { 0x00 }, { 0x01 }, { 0x7f }, { 0x80, 0x01 }, { 0xff, 0x7f }, { 0x80, 0x80, 0x01 }, { 0x80 },
+    };
+
+    uint8_t opcodes[OPCODES_COUNT] = {0};
+    uint32_t forms = 0;
+    uint32_t mismatches = 0;
+
+    for (uint32_t index = 0; index < OPCODES_STACK_WORDS; index++)
+    {
+        // Every popped word is a distinct address within the stack (it may become vsp)
+        opcodes_stack[index] = OPCODES_STACK + 0x200 + 4 * index;
+    }
+
+    AddSegment(image, OPCODES_STACK, sizeof(opcodes_stack), (const uint8_t*) opcodes_stack);
+    AddSegment(image, OPCODES_ENTRY, sizeof(opcodes_entry), (const uint8_t*) opcodes_entry);
+    SetHostImage(image);
+
+    for (uint32_t op = 0; op < 0x100; op++)
+    {
+        opcodes[0] = op;
+
+        for (uint32_t tail = 0; tail < 2; tail++)
+        {
+            mismatches += CheckProgram(opcodes, 1, tail);
+            forms += 1;
+
+            for (uint32_t operand = 0; IsTwoByteOpcode(op) && operand < sizeof(operands); operand++)
+            {
+                opcodes[1] = operands[operand];
+                mismatches += CheckProgram(opcodes, 2, tail);
+                forms += 1;
+            }
+
+            for (uint32_t operand = 0; op == 0xb2 && operand < sizeof(uleb128) / sizeof(uleb128[0]); operand++)
+            {
+                uint32_t length = 1;
+
+                do {
+                    opcodes[length] = uleb128[operand][length - 1];
+                } while (opcodes[length++] & 0x80);
+
+                mismatches += CheckProgram(opcodes, length, tail);
+                forms += 1;
+            }
+        }
+    }
+
+    printf("%u opcode forms decoded, %u mismatches with the reference decoder\n", forms, mismatches);
+
+    return mismatches;
+}
+
+/**
+ * @brief This function decodes an unwinding instruction with DecodeFrame and with the reference
+ * decoder, and prints it if the results differ.
+ * @param[in] opcodes             The bytes of the instruction
+ * @param[in] length              The number of bytes
+ * @param[in] tail                Whether the instruction ends the entry instead of starting it
+ * @return 1 if the results differ, 0 otherwise
+ */
+uint32_t CheckProgram(const uint8_t* opcodes, uint32_t length, uint32_t tail)
+{
+    uint8_t program[OPCODES_COUNT] = {0};
+    unwindRegisters_t expected = {0};
+    unwindRegisters_t vrs = {0};
+    stackBounds_t bounds = { .low = OPCODES_STACK, .high = OPCODES_STACK + sizeof(opcodes_stack) };
+    uint32_t expected_decoded = 0;
+    uint32_t decoded = 0;
+
+    for (uint32_t index = 0; index < OPCODES_COUNT; index++)
+    {
+        program[index] = tail ? 0x00 : 0xb0;
+    }
+
+    memcpy(program + (tail ? OPCODES_COUNT - length : 0), opcodes, length);
+
+    // Lu16 entry with one additional word : 2 + 4 instructions
+    opcodes_entry[0] = 0x81010000 | (program[0] << 8) | program[1];
+    opcodes_entry[1] = (program[2] << 24) | (program[3] << 16) | (program[4] << 8) | program[5];
+
+    for (uint32_t reg = 0; reg < 16; reg++)
+    {
+        // Any register may be the source of vsp, so all of them point within the stack
+        vrs.r[reg] = OPCODES_STACK + 0x40 * reg;
+    }
+
+    vrs.r[13] = OPCODES_STACK;
+    expected = vrs;
+
+    decoded = DecodeFrame(opcodes_entry[0], OPCODES_ENTRY, &vrs, bounds);
+    expected_decoded = ReferenceDecode(program, OPCODES_COUNT, &expected);
+
+    if (decoded == expected_decoded && (!decoded || memcmp(&vrs, &expected, sizeof(vrs)) == 0))
+    {
+        return 0;
+    }
+
+    printf("0x%08x 0x%08x : decoded %u vsp 0x%08x popped 0x%04x, expected %u vsp 0x%08x popped 0x%04x\n",
+        opcodes_entry[0], opcodes_entry[1], decoded, vrs.r[13], vrs.popped,
+        expected_decoded, expected.r[13], expected.popped);
+
+    return 1;
+}
+
+/**
+ * @brief This function unwinds a synthetic call chain, whose registers are carried from frame
+ * to frame : CHAIN_ROOT calls CHAIN_FP, which calls CHAIN_NO_FP, which calls CHAIN_LEAF.
+ *   - Interrupted in CHAIN_LEAF : the return address is only in lr, and CHAIN_FP is reached
+ *     with the r7 left untouched by CHAIN_NO_FP.
+ *   - Interrupted on the first instruction of CHAIN_NO_FP : its prologue has not pushed anything.
+ * @param[in,out] image           The image, receiving the synthetic table and stack
+ * @return The number of call stacks unwound differently
+ */
+uint32_t CheckChain(image_t* image)
+{
+    // Unwinding instructions of each function (Su16 entries)
+    static const uint32_t programs[4] = {
+        0x80b0b0b0,                 // finish
+        0x8001a8b0,                 // vsp = vsp + 8; pop {r4, r14}
+        0x80978408,                 // vsp = r7; pop {r7, r14}
+        EXIDX_CANTUNWIND,
+    };
+
+    unwindRegisters_t registers = {0};
+    uint32_t sp = CHAIN_STACK + 0x10;
+    uint32_t mismatches = 0;
+
+    for (uint32_t index = 0; index < 4; index++)
+    {
+        uint32_t where = CHAIN_EXIDX + 8 * index;
+
+        chain_exidx[2 * index] = (CHAIN_LEAF + 0x100 * index - where) & 0x7fffffff;
+        chain_exidx[2 * index + 1] = programs[index];
+    }
+
+    // CHAIN_NO_FP frame : 8 bytes of locals, r4 and lr, then CHAIN_FP frame : r7 and lr
+    chain_stack[4] = 0x11111111;
+    chain_stack[5] = 0x22222222;
+    chain_stack[6] = 0x44444444;
+    chain_stack[7] = CHAIN_FP + 0x21;
+    chain_stack[8] = CHAIN_STACK + 0x3c;
+    chain_stack[9] = CHAIN_ROOT + 0x41;
+
+    AddSegment(image, CHAIN_EXIDX, sizeof(chain_exidx), (const uint8_t*) chain_exidx);
+    AddSegment(image, CHAIN_STACK, sizeof(chain_stack), (const uint8_t*) chain_stack);
+    image->exidx_start = CHAIN_EXIDX;
+    image->exidx_end = CHAIN_EXIDX + sizeof(chain_exidx);
+    SetHostImage(image);
+
+    // Interrupted in the leaf, r7 still holds the frame pointer of CHAIN_FP
+    registers.r[7] = sp + 0x10;
+    registers.r[13] = sp;
+    registers.r[14] = CHAIN_NO_FP + 0x31;
+    registers.r[15] = CHAIN_LEAF + 0x10;
+
+    mismatches += CheckCallStack("leaf", &registers, (const call_t[]) {
+        { .pc = CHAIN_LEAF + 0x10, .fn = CHAIN_LEAF, .sp = sp },
+        { .pc = CHAIN_NO_FP + 0x30, .fn = CHAIN_NO_FP, .sp = sp },
+        { .pc = CHAIN_FP + 0x20, .fn = CHAIN_FP, .sp = sp + 0x10 },
+        { .pc = CHAIN_ROOT + 0x40, .fn = CHAIN_ROOT, .sp = sp + 0x18 },
+    }, 4);
+
+    // Interrupted before the prologue of CHAIN_NO_FP, on the stack pointer of its caller
+    registers.r[13] = sp + 0x10;
+    registers.r[14] = CHAIN_FP + 0x21;
+    registers.r[15] = CHAIN_NO_FP;
+
+    mismatches += CheckCallStack("prologue", &registers, (const call_t[]) {
+        { .pc = CHAIN_NO_FP, .fn = CHAIN_NO_FP, .sp = sp + 0x10 },
+        { .pc = CHAIN_FP + 0x20, .fn = CHAIN_FP, .sp = sp + 0x10 },
+        { .pc = CHAIN_ROOT + 0x40, .fn = CHAIN_ROOT, .sp = sp + 0x18 },
+    }, 3);
+
+    printf("2 call chains unwound, %u mismatches\n", mismatches);
+
+    return mismatches;
+}
+
+/**
+ * @brief This function unwinds a call stack from the given registers within the synthetic
+ * stack, and prints it if it differs from the expected one (the function starts are only
+ * compared when the unwinder writes them).
+ * @param[in] title               The name of the call stack
+ * @param[in] registers           The registers of the interrupted context
+ * @param[in] expected            The expected frames
+ * @param[in] count               The number of expected frames
+ * @return 1 if the call stacks differ, 0 otherwise
+ */
+uint32_t CheckCallStack(const char* title, const unwindRegisters_t* registers, const call_t* expected, uint32_t count)
+{
+    stackBounds_t bounds = { .low = CHAIN_STACK, .high = CHAIN_STACK + sizeof(chain_stack) };
+    callStack_t call_stack = {0};
+    uint32_t differ = 0;
+
+    UnwindStackInBounds(&call_stack, registers, bounds);
+    differ = call_stack.size != count;
+
+    for (uint32_t frame = 0; frame < count && frame < call_stack.size; frame++)
+    {
+        differ |= call_stack.calls[frame].pc != expected[frame].pc || call_stack.calls[frame].sp != expected[frame].sp;
+        differ |= call_stack.calls[frame].fn != expected[frame].fn;
+    }
+
+    if (!differ)
+    {
+        return 0;
+    }
+
+    printf("%s : %u frames, expected %u\n", title, call_stack.size, count);
+
+    for (uint32_t frame = 0; frame < call_stack.size; frame++)
+    {
+        printf("  #%-2u pc 0x%08x fn 0x%08x sp 0x%08x\n", frame,
+            call_stack.calls[frame].pc, call_stack.calls[frame].fn, call_stack.calls[frame].sp);
+    }
+
+    return 1;
+}
+
+/**
+ * @brief This function is the reference decoder of the opcode forms, written from the opcode
+ * table of the EHABI (Section 10.3) independently of DecodeCompactModelEntry.
+ * @param[in] program             The unwinding instructions
+ * @param[in] count               The number of instructions
+ * @param[in,out] vrs             The virtual register set
+ * @return 1 if the instructions can be executed, 0 if the frame cannot be unwound
+ */
+uint32_t ReferenceDecode(const uint8_t* program, uint32_t count, unwindRegisters_t* vrs)
+{
+    uint32_t index = 0;
+    uint32_t value = 0;
+    uint32_t shift = 0;
+    uint8_t op = 0;
+    uint8_t op2 = 0;
+
+    while (index < count && program[index] != 0xb0)
+    {
+        op = program[index++];
+
+        if (IsTwoByteOpcode(op))
+        {
+            if (index == count)
+            {
+                return 0;
+            }
+            op2 = program[index++];
+        }
+
+        if (op <= 0x3f)
+        {
+            vrs->r[13] += 4 * op + 4;
+        }
+        else if (op <= 0x7f)
+        {
+            vrs->r[13] -= 4 * (op - 0x40) + 4;
+        }
+        else if (op <= 0x8f)
+        {
+            if (op == 0x80 && op2 == 0x00)
+            {
+                return 0;
+            }
+
+            // Bit 0 of the mask is r4
+            if (!ReferencePop(vrs, (((op & 0x0f) << 8) | op2) << 4))
+            {
+                return 0;
+            }
+        }
+        else if (op <= 0x9f)
+        {
+            if (op == 0x9d || op == 0x9f)
+            {
+                return 0;
+            }
+            vrs->r[13] = vrs->r[op - 0x90];
+        }
+        else if (op <= 0xaf)
+        {
+            // r4-r[4+nnn] then r14, popped together
+            if (!ReferencePop(vrs, (((1u << ((op & 0x07) + 1)) - 1) << 4) | (op >= 0xa8 ? 1u << 14 : 0)))
+            {
+                return 0;
+            }
+        }
+        else if (op == 0xb1)
+        {
+            if (op2 == 0x00 || op2 > 0x0f)
+            {
+                return 0;
+            }
+
+            if (!ReferencePop(vrs, op2))
+            {
+                return 0;
+            }
+        }
+        else if (op == 0xb2)
+        {
+            value = op2 & 0x7f;
+            shift = 7;
+
+            while (op2 & 0x80)
+            {
+                if (index == count)
+                {
+                    return 0;
+                }
+                op2 = program[index++];
+                value |= shift < 32 ? (uint32_t) (op2 & 0x7f) << shift : 0;
+                shift += 7;
+            }
+
+            vrs->r[13] += 0x204 + 4 * value;
+        }
+        else if (op == 0xb3 || op == 0xc6 || op == 0xc8 || op == 0xc9)
+        {
+            // The last register of the range must exist (D15, D31 or wR15)
+            if ((op2 >> 4) + (op2 & 0x0f) > 15)
+            {
+                return 0;
+            }
+            vrs->r[13] += 8 * ((op2 & 0x0f) + 1) + (op == 0xb3 ? 4 : 0);
+        }
+        else if (op >= 0xb8 && op <= 0xbf)
+        {
+            vrs->r[13] += 8 * (op - 0xb8 + 1) + 4;
+        }
+        else if (op >= 0xc0 && op <= 0xc5)
+        {
+            vrs->r[13] += 8 * (op - 0xc0 + 1);
+        }
+        else if (op == 0xc7)
+        {
+            if (op2 == 0x00 || op2 > 0x0f)
+            {
+                return 0;
+            }
+            vrs->r[13] += 4 * ((op2 & 1) + ((op2 >> 1) & 1) + ((op2 >> 2) & 1) + ((op2 >> 3) & 1));
+        }
+        else if (op >= 0xd0 && op <= 0xd7)
+        {
+            vrs->r[13] += 8 * (op - 0xd0 + 1);
+        }
+        else
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @brief This function pops core registers in the reference decoder, from the lowest one.
+ * @param[in,out] vrs             The virtual register set
+ * @param[in] mask                The registers to pop (bit n for rn)
+ * @return 1 if the registers lie within the synthetic stack, 0 otherwise
+ */
+uint32_t ReferencePop(unwindRegisters_t* vrs, uint32_t mask)
+{
+    uint32_t vsp = vrs->r[13];
+
+    for (uint32_t reg = 0; reg < 16; reg++)
+    {
+        if (!(mask & (1u << reg)))
+        {
+            continue;
+        }
+
+        if (vsp < OPCODES_STACK || vsp >= OPCODES_STACK + sizeof(opcodes_stack) || (vsp & 0x3))
+        {
+            return 0;
+        }
+
+        vrs->r[reg] = opcodes_stack[(vsp - OPCODES_STACK) / 4];
+        vsp += 4;
+    }
+
+    // Popping r13 loads vsp itself, once all the registers have been read
+    vrs->r[13] = (mask & (1u << 13)) ? vrs->r[13] : vsp;
+    vrs->popped |= mask;
+
+    return 1;
+}
+
+/**
+ * @brief This function tells whether an unwinding instruction has an operand byte.
+ * @param[in] op                  The first byte of the instruction
+ * @return 1 for the two byte forms (and 10110010, whose ULEB128 has at least one byte), 0 otherwise
+ */
+uint32_t IsTwoByteOpcode(uint8_t op)
+{
+    return (op & 0xf0) == 0x80 || op == 0xb1 || op == 0xb2 || op == 0xb3 || (op >= 0xc6 && op <= 0xc9);
+}
@@ -0,0 +1,170 @@
+/**
+ * @file    fuzzunwind.c
+ * @author  Théo Bessel
+ * @brief   libFuzzer harness of the unwinder
+ *
+ * Usage : make fuzz [FUZZ_TIME=<seconds>]
+ *
+ * Each input is split into the registers of the interrupted context, a `.ARM.exidx` table,
+ * a `.ARM.extab` section, an `.unwind_index` section (page, Eytzinger or pool layout, from
+ * its header), an `.unwind_calls` section and a stack window, all loaded with AddSegment,
+ * then unwound with UnwindStackInBounds as on target. Built with clang
+ * (`-fsanitize=fuzzer,address,undefined`) and IMAGE_TRAP_UNMAPPED, so that any read outside
+ * of the loaded segments or any undefined behaviour of the unwinder is reported with the
+ * input that triggered it.
+ *
+ * Input layout (little endian) :
+ *   | fuzzHeader_t | exidx | extab | index | calls | stack (the rest) |
+ *
+ * @copyright Copyright (c) Théo Bessel 2024
+ */
+
+/******************************* Include Files *******************************/
+
+#include <stddef.h>
+#include <string.h>
+#include "stacktrace.h"
+#include "image.h"
+
+/***************************** Macros Definitions ****************************/
+
+// Addresses of the fuzzed segments, the code addresses are whatever the tables point to
+#define FUZZ_EXIDX 0x00010000u
+#define FUZZ_EXTAB 0x00020000u
+#define FUZZ_INDEX 0x00030000u
+#define FUZZ_CALLS 0x00040000u
+#define FUZZ_STACK 0x20000000u
+
+// Capacity of each segment
+#define FUZZ_SEGMENT_SIZE 0x1000u
+
+/***************************** Types Definitions *****************************/
+
+/**
+ * @brief Header of a fuzzer input.
+ */
+typedef struct __attribute__((packed))
+{
+    uint32_t r[4];                  /**< Registers r4-r7.                    */
+    uint32_t sp_offset;             /**< Stack pointer, within the stack.    */
+    uint32_t lr;                    /**< Link register (LR).                 */
+    uint32_t pc;                    /**< Program counter (PC).               */
+    uint16_t exidx_size;            /**< Size of the exidx table.            */
+    uint16_t extab_size;            /**< Size of the extab section.          */
+    uint16_t index_size;            /**< Size of the unwind index.           */
+    uint16_t calls_size;            /**< Size of the call sites table.       */
+} fuzzHeader_t;
+
+/*************************** Functions Declarations **************************/
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+uint32_t TakeSegment(uint32_t* segment, uint32_t wanted, uint32_t align, const uint8_t** data, size_t* size);
+
+/*************************** Variables Definitions ***************************/
+
+/**
+ * @brief Image holding the fuzzed segments
+ */
+static image_t image = {0};
+
+/**
+ * @brief Word aligned copies of the fuzzed segments
+ */
+static uint32_t exidx[FUZZ_SEGMENT_SIZE / 4] = {0};
+static uint32_t extab[FUZZ_SEGMENT_SIZE / 4] = {0};
+static uint32_t unwind_index[FUZZ_SEGMENT_SIZE / 4] = {0};
+static uint32_t unwind_calls[FUZZ_SEGMENT_SIZE / 4] = {0};
+static uint32_t stack[FUZZ_SEGMENT_SIZE / 4] = {0};
+
+/*************************** Functions Definitions ***************************/
+
+/**
+ * @brief This function unwinds a single fuzzer input.
+ * @param[in] data                The input
+ * @param[in] size                The size of the input
+ * @return 0, the input is always kept in the corpus if it covers new code
+ */
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    fuzzHeader_t header = {0};
+    unwindRegisters_t registers = {0};
+    callStack_t call_stack = {0};
+    stackBounds_t bounds = {0};
+    uint32_t exidx_size = 0;
+    uint32_t extab_size = 0;
+    uint32_t index_size = 0;
+    uint32_t calls_size = 0;
+    uint32_t stack_size = 0;
+
+    if (size < sizeof(header))
+    {
+        return 0;
+    }
+
+    memcpy(&header, data, sizeof(header));
+    data += sizeof(header);
+    size -= sizeof(header);
+
+    // The unwinder reads whole table entries : the exidx table is a number of 8 bytes entries
+    exidx_size = TakeSegment(exidx, header.exidx_size, 8, &data, &size);
+    extab_size = TakeSegment(extab, header.extab_size, 4, &data, &size);
+    index_size = TakeSegment(unwind_index, header.index_size, 4, &data, &size);
+    calls_size = TakeSegment(unwind_calls, header.calls_size, 4, &data, &size);
+    stack_size = TakeSegment(stack, FUZZ_SEGMENT_SIZE, 4, &data, &size);
+
+    image = (image_t) {0};
+    AddSegment(&image, FUZZ_EXIDX, exidx_size, (const uint8_t*) exidx);
+    AddSegment(&image, FUZZ_EXTAB, extab_size, (const uint8_t*) extab);
+    AddSegment(&image, FUZZ_INDEX, index_size, (const uint8_t*) unwind_index);
+    AddSegment(&image, FUZZ_CALLS, calls_size, (const uint8_t*) unwind_calls);
+    AddSegment(&image, FUZZ_STACK, stack_size, (const uint8_t*) stack);
+    image.exidx_start = FUZZ_EXIDX;
+    image.exidx_end = FUZZ_EXIDX + exidx_size;
+    image.extab_start = FUZZ_EXTAB;
+    image.extab_end = FUZZ_EXTAB + extab_size;
+    image.unwind_index_start = FUZZ_INDEX;
+    image.unwind_index_end = FUZZ_INDEX + index_size;
+    image.unwind_calls_start = FUZZ_CALLS;
+    image.unwind_calls_end = FUZZ_CALLS + calls_size;
+    SetHostImage(&image);
+
+    for (uint32_t reg = 0; reg < 4; reg++)
+    {
+        registers.r[4 + reg] = header.r[reg];
+    }
+
+    registers.r[13] = FUZZ_STACK + header.sp_offset;
+    registers.r[14] = header.lr;
+    registers.r[15] = header.pc;
+
+    bounds.low = FUZZ_STACK;
+    bounds.high = FUZZ_STACK + stack_size;
+
+    UnwindStackInBounds(&call_stack, &registers, bounds);
+    ResolveCallStack(&call_stack);
+
+    return 0;
+}
+
+/**
+ * @brief This function copies the next segment of an input to its word aligned buffer.
+ * @param[out] segment            The buffer of the segment (FUZZ_SEGMENT_SIZE bytes)
+ * @param[in] wanted              The size of the segment given by the header
+ * @param[in] align               The granularity of the segment size
+ * @param[in,out] data            The rest of the input
+ * @param[in,out] size            The size of the rest of the input
+ * @return The size of the segment, the bytes after it up to the granularity are zeroed
+ */
+uint32_t TakeSegment(uint32_t* segment, uint32_t wanted, uint32_t align, const uint8_t** data, size_t* size)
+{
+    uint32_t taken = wanted < *size ? wanted : *size;
+
+    taken = taken < FUZZ_SEGMENT_SIZE ? taken : FUZZ_SEGMENT_SIZE;
+
+    memset(segment, 0, FUZZ_SEGMENT_SIZE);
+    memcpy(segment, *data, taken);
+    *data += taken;
+    *size -= taken;
+
+    return taken & ~(align - 1);
+}
@@ -0,0 +1,435 @@
+/**
+ * @file    image.c
+ * @author  Théo Bessel
+ * @brief   Host view of the target memory (ELF sections and dumped memory)
+ *
+ * The unwinder built with STACKTRACE_HOST reads the target memory through HostReadWord,
+ * which is served from the allocated sections of the ELF and from any memory added with
+ * AddSegment (e.g. a dumped stack window). An address outside of them reads as 0, unless
+ * IMAGE_TRAP_UNMAPPED is set (see `make fuzz`) : the read then traps, so that a decoder
+ * reading past its tables or its stack window is reported.
+ *
+ * @copyright Copyright (c) Théo Bessel 2024
+ */
+
+/******************************* Include Files *******************************/
+
+#include <elf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "image.h"
+
+/***************************** Macros Definitions ****************************/
+
+#ifndef IMAGE_TRAP_UNMAPPED
+#define IMAGE_TRAP_UNMAPPED 0
+#endif
+
+/*************************** Functions Declarations **************************/
+
+uint8_t* ReadFile(const char* path, uint32_t* size);
+int LoadImage(image_t* image, const char* path);
+void FreeImage(image_t* image);
+int AddSegment(image_t* image, uint32_t address, uint32_t size, const uint8_t* data);
+void SetHostImage(image_t* image);
+const char* FindSymbol(const image_t* image, uint32_t address, uint32_t* offset);
+uint32_t BuildEytzinger(const uint32_t* sorted, uint32_t count, uint32_t* keys, uint32_t* order, uint32_t position, uint32_t node);
+uint32_t SearchEytzinger(const uint32_t* keys, uint32_t count, uint32_t key);
+
+uint32_t HostReadWord(uint32_t address);
+int CompareSymbols(const void* a, const void* b);
+void BuildSymbolIndex(image_t* image);
+
+/*************************** Variables Definitions ***************************/
+
+/**
+ * @brief Image read by the unwinder
+ */
+static image_t* host_image = NULL;
+
+/**
+ * @brief `.ARM.exidx`, `.ARM.extab`, `.unwind_index` and `.unwind_calls` bounds used by the unwinder
+ */
+uint32_t host_exidx_start = 0;
+uint32_t host_exidx_end = 0;
+uint32_t host_extab_start = 0;
+uint32_t host_extab_end = 0;
+uint32_t host_unwind_index_start = 0;
+uint32_t host_unwind_index_end = 0;
+uint32_t host_unwind_calls_start = 0;
+uint32_t host_unwind_calls_end = 0;
+
+/*************************** Functions Definitions ***************************/
+
+/**
+ * @brief This function reads a whole file in memory.
+ * @param[in] path                The path of the file
+ * @param[out] size               The size of the file
+ * @return The content of the file (to free), or NULL on error
+ */
+uint8_t* ReadFile(const char* path, uint32_t* size)
+{
+    FILE* file = fopen(path, "rb");
+    uint8_t* buffer = NULL;
+    long length = 0;
+
+    if (file == NULL)
+    {
+        perror(path);
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    buffer = malloc(length > 0 ? length : 1);
+    if (buffer != NULL && fread(buffer, 1, length, file) != (size_t) length)
+    {
+        perror(path);
+        free(buffer);
+        buffer = NULL;
+    }
+
+    fclose(file);
+    *size = (uint32_t) length;
+
+    return buffer;
+}
+
+/**
+ * @brief This function loads the allocated sections and the function symbols of an ELF.
+ * @param[out] image              The image to fill
+ * @param[in] path                The path of the ELF (32-bit, little-endian)
+ * @return 0 on success, -1 on error
+ */
+int LoadImage(image_t* image, const char* path)
+{
+    const Elf32_Ehdr* header = NULL;
+    const Elf32_Shdr* sections = NULL;
+    const char* names = NULL;
+
+    memset(image, 0, sizeof(*image));
+
+    image->file = ReadFile(path, &image->file_size);
+    if (image->file == NULL)
+    {
+        return -1;
+    }
+
+    header = (const Elf32_Ehdr *) image->file;
+    if (
+        image->file_size < sizeof(Elf32_Ehdr)
+        || memcmp(header->e_ident, ELFMAG, SELFMAG) != 0
+        || header->e_ident[EI_CLASS] != ELFCLASS32
+        || header->e_ident[EI_DATA] != ELFDATA2LSB
+        || header->e_shoff + header->e_shnum * sizeof(Elf32_Shdr) > image->file_size
+    )
+    {
+        fprintf(stderr, "%s: not a 32-bit little-endian ELF\n", path);
+        return -1;
+    }
+
+    sections = (const Elf32_Shdr *) (image->file + header->e_shoff);
+    names = (const char *) (image->file + sections[header->e_shstrndx].sh_offset);
+
+    for (uint32_t index = 0; index < header->e_shnum; index++)
+    {
+        const Elf32_Shdr* section = &sections[index];
+        const char* name = names + section->sh_name;
+
+        if (section->sh_offset + (section->sh_type == SHT_NOBITS ? 0 : section->sh_size) > image->file_size)
+        {
+            continue;
+        }
+
+        if ((section->sh_flags & SHF_ALLOC) && section->sh_type != SHT_NOBITS)
+        {
+            AddSegment(image, section->sh_addr, section->sh_size, image->file + section->sh_offset);
+        }
+
+        if (strcmp(name, ".ARM.exidx") == 0)
+        {
+            image->exidx_start = section->sh_addr;
+            image->exidx_end = section->sh_addr + section->sh_size;
+        }
+        else if (strcmp(name, ".ARM.extab") == 0)
+        {
+            image->extab_start = section->sh_addr;
+            image->extab_end = section->sh_addr + section->sh_size;
+        }
+        else if (strcmp(name, ".unwind_index") == 0)
+        {
+            image->unwind_index_start = section->sh_addr;
+            image->unwind_index_end = section->sh_addr + section->sh_size;
+        }
+        else if (strcmp(name, ".unwind_calls") == 0)
+        {
+            image->unwind_calls_start = section->sh_addr;
+            image->unwind_calls_end = section->sh_addr + section->sh_size;
+        }
+        else if (strcmp(name, ".text") == 0)
+        {
+            image->text_start = section->sh_addr;
+            image->text_end = section->sh_addr + section->sh_size;
+        }
+        else if (strcmp(name, ".isr_vector") == 0)
+        {
+            image->vectors_start = section->sh_addr;
+            image->vectors_end = section->sh_addr + section->sh_size;
+        }
+        else if (section->sh_type == SHT_SYMTAB && section->sh_link < header->e_shnum)
+        {
+            const Elf32_Sym* symbols = (const Elf32_Sym *) (image->file + section->sh_offset);
+            const char* strings = (const char *) (image->file + sections[section->sh_link].sh_offset);
+            uint32_t count = section->sh_size / sizeof(Elf32_Sym);
+
+            image->symbols = calloc(count + 1, sizeof(symbol_t));
+
+            for (uint32_t symbol = 0; symbol < count && image->symbols != NULL; symbol++)
+            {
+                if (ELF32_ST_TYPE(symbols[symbol].st_info) == STT_FUNC)
+                {
+                    image->symbols[image->symbol_count].address = symbols[symbol].st_value & ~1u;
+                    image->symbols[image->symbol_count].size = symbols[symbol].st_size;
+                    image->symbols[image->symbol_count].name = strings + symbols[symbol].st_name;
+                    image->symbol_count += 1;
+                }
+            }
+
+            if (image->symbols != NULL)
+            {
+                qsort(image->symbols, image->symbol_count, sizeof(symbol_t), CompareSymbols);
+                BuildSymbolIndex(image);
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief This function releases an image.
+ * @param[in] image               The image to release
+ * @return Nothing
+ */
+void FreeImage(image_t* image)
+{
+    free(image->symbol_keys);
+    free(image->symbol_order);
+    free(image->symbols);
+    free(image->file);
+    memset(image, 0, sizeof(*image));
+}
+
+/**
+ * @brief This function adds a readable range of target memory to an image.
+ * @note Segments added last take precedence, so a dumped stack hides the ELF content.
+ * @param[in,out] image           The image
+ * @param[in] address             The target address of the range
+ * @param[in] size                The size of the range
+ * @param[in] data                The content of the range (not copied)
+ * @return 0 on success, -1 if there are too many segments
+ */
+int AddSegment(image_t* image, uint32_t address, uint32_t size, const uint8_t* data)
+{
+    if (image->segment_count >= IMAGE_MAX_SEGMENTS)
+    {
+        return -1;
+    }
+
+    image->segments[image->segment_count].address = address;
+    image->segments[image->segment_count].size = size;
+    image->segments[image->segment_count].data = data;
+    image->segment_count += 1;
+
+    return 0;
+}
+
+/**
+ * @brief This function selects the image read by the unwinder.
+ * @param[in] image               The image
+ * @return Nothing
+ */
+void SetHostImage(image_t* image)
+{
+    host_image = image;
+    host_exidx_start = image->exidx_start;
+    host_exidx_end = image->exidx_end;
+    host_extab_start = image->extab_start;
+    host_extab_end = image->extab_end;
+    host_unwind_index_start = image->unwind_index_start;
+    host_unwind_index_end = image->unwind_index_end;
+    host_unwind_calls_start = image->unwind_calls_start;
+    host_unwind_calls_end = image->unwind_calls_end;
+}
+
+/**
+ * @brief This function finds the function containing an address.
+ * @param[in] image               The image
+ * @param[in] address             The address
+ * @param[out] offset             The offset of the address in the function (may be NULL)
+ * @return The name of the function, or NULL if unknown
+ */
+const char* FindSymbol(const image_t* image, uint32_t address, uint32_t* offset)
+{
+    uint32_t low = 0;
+    uint32_t high = image->symbol_count;
+
+    // Last symbol starting at or before the address, found in the Eytzinger copy if any
+    if (image->symbol_keys != NULL)
+    {
+        low = SearchEytzinger(image->symbol_keys, image->symbol_count, address);
+        low = low == 0 ? image->symbol_count : image->symbol_order[low];
+        high = low;
+    }
+
+    while (low < high)
+    {
+        uint32_t middle = low + (high - low) / 2;
+
+        if (image->symbols[middle].address <= address)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    // Symbols without size (assembly) contain every address up to the next symbol
+    if (
+        low == 0
+        || (image->symbols[low - 1].size != 0
+            && address - image->symbols[low - 1].address >= image->symbols[low - 1].size)
+    )
+    {
+        return NULL;
+    }
+
+    if (offset != NULL)
+    {
+        *offset = address - image->symbols[low - 1].address;
+    }
+
+    return image->symbols[low - 1].name;
+}
+
+/**
+ * @brief This function lays out sorted keys in Eytzinger (BFS) order, by an in-order walk
+ * of the implicit tree (children of node n are 2n and 2n + 1, the root is 1).
+ * @param[in] sorted              The sorted keys
+ * @param[in] count               The number of keys
+ * @param[out] keys               The keys in BFS order (`count + 1`, 0 unused)
+ * @param[out] order              The sorted position of each key (`count + 1`, 0 unused)
+ * @param[in] position            The next sorted key to place (0 at the root)
+ * @param[in] node                The node of the walk (1 at the root)
+ * @return The next sorted key to place
+ */
+uint32_t BuildEytzinger(const uint32_t* sorted, uint32_t count, uint32_t* keys, uint32_t* order, uint32_t position, uint32_t node)
+{
+    if (node <= count)
+    {
+        position = BuildEytzinger(sorted, count, keys, order, position, 2 * node);
+        keys[node] = sorted[position];
+        order[node] = position;
+        position = BuildEytzinger(sorted, count, keys, order, position + 1, 2 * node + 1);
+    }
+
+    return position;
+}
+
+/**
+ * @brief This function searches keys in Eytzinger order without branch on the comparison,
+ * while prefetching the cache line holding the nodes four levels below.
+ * @param[in] keys                The keys in BFS order
+ * @param[in] count               The number of keys
+ * @param[in] key                 The searched key
+ * @return The node of the first key above the searched key, 0 if there is none
+ */
+uint32_t SearchEytzinger(const uint32_t* keys, uint32_t count, uint32_t key)
+{
+    uint32_t node = 1;
+
+    while (node <= count)
+    {
+        __builtin_prefetch(keys + (EYTZINGER_PREFETCH * node <= count ? EYTZINGER_PREFETCH * node : 0));
+        node = 2 * node + (keys[node] <= key);
+    }
+
+    // Dropping the trailing right turns and the last left turn
+    return node >> __builtin_ffs(~node);
+}
+
+/**
+ * @brief This function reads a target word, as the unwinder would on target.
+ * @param[in] address             The target address
+ * @return The word, or 0 if the address is not in the image (trap with IMAGE_TRAP_UNMAPPED)
+ */
+uint32_t HostReadWord(uint32_t address)
+{
+    uint32_t word = 0;
+
+    for (uint32_t index = host_image->segment_count; index > 0; index--)
+    {
+        const segment_t* segment = &host_image->segments[index - 1];
+
+        if (address >= segment->address && address - segment->address + 4 <= segment->size)
+        {
+            memcpy(&word, segment->data + (address - segment->address), sizeof(word));
+            return word;
+        }
+    }
+
+#if IMAGE_TRAP_UNMAPPED
+    __builtin_trap();
+#endif
+
+    return 0;
+}
+
+/**
+ * @brief This function builds the Eytzinger copy of the symbol addresses used by FindSymbol,
+ * which falls back on a binary search over the symbols if it can not be allocated.
+ * @param[in,out] image           The image, with symbols sorted by address
+ * @return Nothing
+ */
+void BuildSymbolIndex(image_t* image)
+{
+    uint32_t* sorted = malloc((image->symbol_count + 1) * sizeof(uint32_t));
+
+    image->symbol_keys = malloc((image->symbol_count + 1) * sizeof(uint32_t));
+    image->symbol_order = malloc((image->symbol_count + 1) * sizeof(uint32_t));
+
+    if (sorted == NULL || image->symbol_keys == NULL || image->symbol_order == NULL)
+    {
+        free(image->symbol_keys);
+        free(image->symbol_order);
+        image->symbol_keys = NULL;
+        image->symbol_order = NULL;
+    }
+    else
+    {
+        for (uint32_t symbol = 0; symbol < image->symbol_count; symbol++)
+        {
+            sorted[symbol] = image->symbols[symbol].address;
+        }
+
+        BuildEytzinger(sorted, image->symbol_count, image->symbol_keys, image->symbol_order, 0, 1);
+    }
+
+    free(sorted);
+}
+
+/**
+ * @brief This function orders symbols by address (qsort).
+ */
+int CompareSymbols(const void* a, const void* b)
+{
+    const symbol_t* first = a;
+    const symbol_t* second = b;
+
+    return (first->address > second->address) - (first->address < second->address);
+}
@@ -0,0 +1,83 @@
+/**
+ * @file    image.h
+ * @author  Théo Bessel
+ * @brief   Host view of the target memory (ELF sections and dumped memory)
+ *
+ * @copyright Copyright (c) Théo Bessel 2024
+ */
+
+#ifndef IMAGE_H
+#define IMAGE_H
+
+/******************************* Include Files *******************************/
+
+#include <stdint.h>
+
+/***************************** Macros Definitions ****************************/
+
+#define IMAGE_MAX_SEGMENTS 32u
+
+// Eytzinger nodes fetched ahead of a lookup : 4 levels, 16 keys, one 64 bytes cache line
+#define EYTZINGER_PREFETCH 16u
+
+/***************************** Types Definitions *****************************/
+
+/**
+ * @brief Structure to describe a readable range of target memory.
+ */
+typedef struct
+{
+    uint32_t address;               /**< Target address of the range.        */
+    uint32_t size;                  /**< Size of the range.                  */
+    const uint8_t* data;            /**< Host copy of the range.             */
+} segment_t;
+
+/**
+ * @brief Structure to describe a function symbol.
+ */
+typedef struct
+{
+    uint32_t address;               /**< Start address (Thumb bit cleared).  */
+    uint32_t size;                  /**< Size of the function.               */
+    const char* name;               /**< Name of the function.               */
+} symbol_t;
+
+/**
+ * @brief Structure to store a target image loaded on host.
+ */
+typedef struct
+{
+    uint8_t* file;                              /**< ELF file content.        */
+    uint32_t file_size;                         /**< ELF file size.           */
+    uint32_t segment_count;                     /**< Number of segments.      */
+    segment_t segments[IMAGE_MAX_SEGMENTS];     /**< Readable memory.         */
+    uint32_t symbol_count;                      /**< Number of functions.     */
+    symbol_t* symbols;                          /**< Functions, by address.   */
+    uint32_t* symbol_keys;                      /**< Addresses, BFS order.    */
+    uint32_t* symbol_order;                     /**< Symbol of each key.      */
+    uint32_t exidx_start;                       /**< `.ARM.exidx` start.      */
+    uint32_t exidx_end;                         /**< `.ARM.exidx` end.        */
+    uint32_t extab_start;                       /**< `.ARM.extab` start.      */
+    uint32_t extab_end;                         /**< `.ARM.extab` end.        */
+    uint32_t unwind_index_start;                /**< `.unwind_index` start.   */
+    uint32_t unwind_index_end;                  /**< `.unwind_index` end.     */
+    uint32_t unwind_calls_start;                /**< `.unwind_calls` start.   */
+    uint32_t unwind_calls_end;                  /**< `.unwind_calls` end.     */
+    uint32_t text_start;                        /**< `.text` start.           */
+    uint32_t text_end;                          /**< `.text` end.             */
+    uint32_t vectors_start;                     /**< `.isr_vector` start.     */
+    uint32_t vectors_end;                       /**< `.isr_vector` end.       */
+} image_t;
+
+/*************************** Functions Declarations **************************/
+
+extern uint8_t* ReadFile(const char* path, uint32_t* size);
+extern int LoadImage(image_t* image, const char* path);
+extern void FreeImage(image_t* image);
+extern int AddSegment(image_t* image, uint32_t address, uint32_t size, const uint8_t* data);
+extern void SetHostImage(image_t* image);
+extern const char* FindSymbol(const image_t* image, uint32_t address, uint32_t* offset);
+extern uint32_t BuildEytzinger(const uint32_t* sorted, uint32_t count, uint32_t* keys, uint32_t* order, uint32_t position, uint32_t node);
+extern uint32_t SearchEytzinger(const uint32_t* keys, uint32_t count, uint32_t key);
+
+#endif /* IMAGE_H */
@@ -0,0 +1,771 @@
+/**
+ * @file    stackdepth.c
+ * @author  Théo Bessel
+ * @brief   Static worst-case stack depth of the target
+ *
+ * Usage : stackdepth <target.elf> [<function> ...]
+ *         stackdepth <target.elf> --check <trace.log>
+ *
+ * The frame of each function of `.ARM.exidx` is read from its unwind program : the vsp
+ * increments (`00xxxxxx`, `0xb2`) and the registers popped undo exactly what the prologue
+ * pushed and reserved. The call graph is recovered from the `BL <label>` of `.text`, decoded
+ * instruction by instruction from the start of each function, and from the `B` to another
+ * function (tail calls, counted as calls). The worst-case depth of a function is its frame
+ * plus the deepest of its callees, and is reported with its path for each entry point : the
+ * handlers of the vector table by default, or the given functions.
+ *
+ * The result is a bound unless it is flagged :
+ *   - `?` a frame on the path can not be sized (EXIDX_CANTUNWIND, refused or spare opcode),
+ *     or grows at run time (alloca, VLA) : its code lowers sp by a register (`SUB SP, SP, Rm`,
+ *     `ADD SP, Rm`) or moves a register to sp other than the one its unwind program restores
+ *     vsp from (`vsp = r<n>`, the frame pointer), so only its static part is known,
+ *   - `i` a function on the path makes indirect calls (`BLX <Rm>`), not followed,
+ *   - `r` the path is recursive, its depth is unbounded.
+ * The exception frames stacked by the preemptions (32 or 104 bytes each, plus the handlers)
+ * are not included.
+ *
+ * With `--check`, the bound of the reset handler is compared with the peak usage of the main
+ * stack measured on target (`*** stack 0 peak ...` lines of the text trace, see stackwatch.c) :
+ * a runtime peak above the static bound means that the analysis misses a path.
+ *
+ * @copyright Copyright (c) Théo Bessel 2024
+ */
+
+/******************************* Include Files *******************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stacktrace.h"
+#include "image.h"
+
+/***************************** Macros Definitions ****************************/
+
+// CantUnwind symbol
+#define EXIDX_CANTUNWIND 0x1
+
+// Function flags, propagated from the callees
+#define DEPTH_UNKNOWN   0x1u            /**< A frame can not be sized.                     */
+#define DEPTH_INDIRECT  0x2u            /**< An indirect call is not followed.             */
+#define DEPTH_RECURSIVE 0x4u            /**< A call cycle is reachable.                    */
+
+// No frame pointer : the unwind program does not restore vsp from a register
+#define ANCHOR_NONE 0xffffffffu
+
+// Depth-first search states
+#define STATE_NEW       0x0u
+#define STATE_ACTIVE    0x1u
+#define STATE_DONE      0x2u
+#define STATE_REPORTED  0x3u
+
+// No function (call target that is not a function start, end of a path)
+#define FUNCTION_NONE 0xffffffffu
+
+// Vector of the reset handler, after the initial stack pointer
+#define RESET_VECTOR 1u
+
+/***************************** Types Definitions *****************************/
+
+/**
+ * @brief Structure to describe a function and its worst-case stack depth.
+ */
+typedef struct
+{
+    uint32_t start;                 /**< Start of the function.              */
+    uint32_t end;                   /**< Start of the next function.         */
+    uint32_t frame;                 /**< Frame size, from the unwind program.*/
+    uint32_t anchor;                /**< Frame pointer, or ANCHOR_NONE.      */
+    uint32_t flags;                 /**< DEPTH_* flags, callees included.    */
+    uint32_t depth;                 /**< Worst-case depth, callees included. */
+    uint32_t deepest;               /**< Callee on the worst-case path.      */
+    uint32_t state;                 /**< Depth-first search state.           */
+    uint32_t first_call;            /**< First callee in the calls array.    */
+    uint32_t call_count;            /**< Number of callees.                  */
+} function_t;
+
+/**
+ * @brief Structure to store the call graph of an image.
+ */
+typedef struct
+{
+    uint32_t count;                 /**< Number of functions.                */
+    function_t* functions;          /**< Functions, by address.              */
+    uint32_t call_count;            /**< Number of calls.                    */
+    uint32_t call_capacity;         /**< Size of the calls array.            */
+    uint32_t* calls;                /**< Callee of each call, by caller.     */
+} callGraph_t;
+
+/*************************** Functions Declarations **************************/
+
+int BuildCallGraph(const image_t* image, callGraph_t* graph);
+uint32_t GetFrameSize(exidxEntry_t entry, uint32_t* size, uint32_t* anchor);
+uint32_t GetProgramSize(uint32_t entry_ptr, uint32_t word, uint32_t count, uint32_t offset, uint32_t* size, uint32_t* anchor);
+void AddCalls(callGraph_t* graph, uint32_t index);
+void ComputeDepth(callGraph_t* graph, uint32_t index);
+uint32_t FindFunction(const callGraph_t* graph, uint32_t address);
+uint32_t FindFunctionByName(const image_t* image, const callGraph_t* graph, const char* name);
+void ReportDepth(const image_t* image, const callGraph_t* graph, uint32_t index);
+void PrintFunction(const image_t* image, uint32_t address);
+int CheckPeak(const image_t* image, const callGraph_t* graph, const char* path);
+uint32_t PopCount(uint32_t mask);
+uint32_t ReadHalfword(uint32_t address);
+void FreeCallGraph(callGraph_t* graph);
+
+/*************************** Functions Definitions ***************************/
+
+int main(int argc, char** argv)
+{
+    image_t image = {0};
+    callGraph_t graph = {0};
+    uint32_t index = 0;
+    int status = EXIT_SUCCESS;
+
+    if (argc < 2 || (argc >= 3 && strcmp(argv[2], "--check") == 0 && argc != 4))
+    {
+        fprintf(stderr, "Usage: %s <target.elf> [<function> ...]\n", argv[0]);
+        fprintf(stderr, "       %s <target.elf> --check <trace.log>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (LoadImage(&image, argv[1]) != 0)
+    {
+        return EXIT_FAILURE;
+    }
+
+    SetHostImage(&image);
+
+    if (BuildCallGraph(&image, &graph) != 0)
+    {
+        fprintf(stderr, "%s: no unwind table to analyze\n", argv[1]);
+        FreeImage(&image);
+        return EXIT_FAILURE;
+    }
+
+    for (uint32_t function = 0; function < graph.count; function++)
+    {
+        ComputeDepth(&graph, function);
+    }
+
+    if (argc == 4 && strcmp(argv[2], "--check") == 0)
+    {
+        status = CheckPeak(&image, &graph, argv[3]) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    else
+    {
+        printf("Worst-case stack depth (bytes), flags : ? unknown frame, i indirect call, r recursion\n");
+        printf("  depth  frame flags entry point, worst-case path\n");
+
+        if (argc > 2)
+        {
+            for (int arg = 2; arg < argc; arg++)
+            {
+                index = FindFunctionByName(&image, &graph, argv[arg]);
+
+                if (index == FUNCTION_NONE)
+                {
+                    fprintf(stderr, "%s: no function '%s' in the unwind table\n", argv[1], argv[arg]);
+                    status = EXIT_FAILURE;
+                    continue;
+                }
+
+                ReportDepth(&image, &graph, index);
+            }
+        }
+        else
+        {
+            // Every handler of the vector table, once
+            for (uint32_t vector = image.vectors_start + 4 * RESET_VECTOR; vector + 4 <= image.vectors_end; vector += 4)
+            {
+                index = FindFunction(&graph, HostReadWord(vector) & ~0x1u);
+
+                if (index != FUNCTION_NONE && graph.functions[index].state != STATE_REPORTED)
+                {
+                    ReportDepth(&image, &graph, index);
+                    graph.functions[index].state = STATE_REPORTED;
+                }
+            }
+        }
+    }
+
+    FreeCallGraph(&graph);
+    FreeImage(&image);
+
+    return status;
+}
+
+/**
+ * @brief This function builds the call graph of an image : one function per `.ARM.exidx`
+ * entry, with its frame size and the functions it calls.
+ * @param[in] image               The image
+ * @param[out] graph              The call graph (to free with FreeCallGraph)
+ * @return 0 on success, -1 if the image has no unwind table
+ */
+int BuildCallGraph(const image_t* image, callGraph_t* graph)
+{
+    uint32_t entries_count = (image->exidx_end - image->exidx_start) / 8;
+    exidxEntry_t entry = {0};
+
+    graph->functions = calloc(entries_count + 1, sizeof(function_t));
+    // At most one call per halfword of `.text`
+    graph->call_capacity = (image->text_end - image->text_start) / 2 + 1;
+    graph->calls = calloc(graph->call_capacity, sizeof(uint32_t));
+
+    if (graph->functions == NULL || graph->calls == NULL || entries_count == 0)
+    {
+        return -1;
+    }
+
+    for (uint32_t index = 0; index < entries_count; index++)
+    {
+        function_t* function = &graph->functions[graph->count];
+
+        entry = GetExidxEntry(image->exidx_start, 8 * index);
+
+        // The linker may emit several entries for the same address, the last one wins
+        if (graph->count > 0 && graph->functions[graph->count - 1].start == entry.decoded_fn)
+        {
+            function = &graph->functions[graph->count - 1];
+        }
+        else
+        {
+            graph->count++;
+        }
+
+        function->start = entry.decoded_fn;
+        function->end = image->text_end;
+        function->deepest = FUNCTION_NONE;
+        function->flags = GetFrameSize(entry, &function->frame, &function->anchor) ? 0 : DEPTH_UNKNOWN;
+    }
+
+    for (uint32_t index = 0; index < graph->count; index++)
+    {
+        if (index + 1 < graph->count)
+        {
+            graph->functions[index].end = graph->functions[index + 1].start;
+        }
+
+        AddCalls(graph, index);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief This function gives the frame size of a function from its unwind program, fetched
+ * as UnwindNextFrame does.
+ * @param[in] entry               The `.ARM.exidx` entry of the function
+ * @param[out] size               The frame size, in bytes
+ * @param[out] anchor             The register vsp is restored from, or ANCHOR_NONE
+ * @return 1 if the program has been sized, 0 if the frame can not be unwound
+ */
+uint32_t GetFrameSize(exidxEntry_t entry, uint32_t* size, uint32_t* anchor)
+{
+    uint32_t word = entry.exidx_entry;
+    uint32_t entry_ptr = entry.decoded_entry;
+
+    *size = 0;
+    *anchor = ANCHOR_NONE;
+
+    if (entry.exidx_entry == EXIDX_CANTUNWIND)
+    {
+        return 0;
+    }
+
+    if ((entry.exidx_entry & 0x80000000) == 0)
+    {
+        word = GetWord(entry.decoded_entry, 0);
+
+        // Generic model : the instructions follow the personality routine, Lu16-like
+        if ((word & 0x80000000) == 0)
+        {
+            word = GetWord(entry.decoded_entry, 4);
+            return GetProgramSize(entry.decoded_entry + 4, word, 3 + 4 * (word >> 24), 1, size, anchor);
+        }
+    }
+
+    switch ((word >> 24) & 0xf)
+    {
+        case 0:
+            return GetProgramSize(entry_ptr, word, 3, 1, size, anchor);
+        case 1:
+        case 2:
+            return GetProgramSize(entry_ptr, word, 2 + 4 * ((word >> 16) & 0xff), 2, size, anchor);
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief This function sums the stack released by a sequence of unwind instructions : the
+ * vsp increments and the registers popped (EHABI Section 10.3).
+ * @note `vsp = r<n>` is skipped, as are the vsp decrements : they only undo the offset of
+ * the frame pointer (`.setfp`), and skipping them can only overestimate the part of the frame
+ * above it. What lies below the frame pointer is not described by the program, AddCalls
+ * flags the functions that grow their frame at run time.
+ * @param[in] entry_ptr           The address of the words holding the instructions
+ * @param[in] word                The first word holding the instructions
+ * @param[in] count               The number of instructions
+ * @param[in] offset              The number of bytes of the first word before the instructions
+ * @param[out] size               The frame size, in bytes
+ * @param[out] anchor             The register of `vsp = r<n>`, left untouched if there is none
+ * @return 1 if the instructions have been sized up to `finish` or to the last one, 0 on
+ * `Refuse to unwind`, on a reserved or spare instruction, or on a truncated one
+ */
+uint32_t GetProgramSize(uint32_t entry_ptr, uint32_t word, uint32_t count, uint32_t offset, uint32_t* size, uint32_t* anchor)
+{
+    uint8_t instructions[3 + 4 * 255] = {0};
+    uint32_t value = 0;
+    uint32_t shift = 0;
+    uint8_t op = 0;
+    uint8_t op2 = 0;
+
+    for (uint32_t instruction = 0; instruction < count; instruction++)
+    {
+        instructions[instruction] = GetInstruction(entry_ptr, word, instruction, offset);
+    }
+
+    for (uint32_t instruction = 0; instruction < count; instruction++)
+    {
+        op = instructions[instruction];
+        op2 = instruction + 1 < count ? instructions[instruction + 1] : 0;
+
+        if ((op & 0xc0) == 0x00)                                    // vsp = vsp + (xxxxxx << 2) + 4
+        {
+            *size += ((op & 0x3f) << 2) + 4;
+            continue;
+        }
+        if ((op & 0xf0) == 0x90 && op != 0x9d && op != 0x9f)       // vsp = r<n>
+        {
+            *anchor = op & 0x0f;
+            continue;
+        }
+        if ((op & 0xc0) == 0x40)                                    // vsp = vsp - ...
+        {
+            continue;
+        }
+        if ((op & 0xf8) == 0xa0 || (op & 0xf8) == 0xa8)             // pop {r4-r[4+nnn]} (+ r14)
+        {
+            *size += 4 * ((op & 0x07) + 1 + ((op & 0x08) ? 1 : 0));
+            continue;
+        }
+        if (op == 0xb0)                                             // finish
+        {
+            return 1;
+        }
+        if ((op & 0xf8) == 0xb8)                                    // pop {D8-D[8+nnn]} (FSTMFDX)
+        {
+            *size += 8 * ((op & 0x07) + 1) + 4;
+            continue;
+        }
+        if ((op & 0xf8) == 0xd0)                                    // pop {D8-D[8+nnn]}
+        {
+            *size += 8 * ((op & 0x07) + 1);
+            continue;
+        }
+        if ((op & 0xf8) == 0xc0 && op != 0xc6 && op != 0xc7)        // pop {wR10-wR[10+nnn]}
+        {
+            *size += 8 * ((op & 0x07) + 1);
+            continue;
+        }
+
+        // Two-byte (or longer) instructions
+        if (instruction + 1 >= count)
+        {
+            return 0;
+        }
+
+        instruction++;
+
+        if ((op & 0xf0) == 0x80 && (op != 0x80 || op2 != 0x00))     // pop {r4-r15} under mask
+        {
+            *size += 4 * PopCount(((op & 0x0f) << 8) | op2);
+        }
+        else if ((op == 0xb1 || op == 0xc7) && op2 != 0 && (op2 & 0xf0) == 0) // pop {r0-r3}, {wCGR0-3}
+        {
+            *size += 4 * PopCount(op2);
+        }
+        else if (op == 0xb2)                                        // vsp = vsp + 0x204 + (uleb128 << 2)
+        {
+            value = 0;
+            shift = 0;
+
+            while ((instructions[instruction] & 0x80) && instruction + 1 < count && shift < 28)
+            {
+                value |= (instructions[instruction++] & 0x7f) << shift;
+                shift += 7;
+            }
+
+            if (instructions[instruction] & 0x80)
+            {
+                return 0;
+            }
+
+            value |= instructions[instruction] << shift;
+            *size += 0x204 + (value << 2);
+        }
+        else if (op == 0xb3)                                        // pop {D[ssss]-D[ssss+cccc]} (FSTMFDX)
+        {
+            *size += 8 * ((op2 & 0x0f) + 1) + 4;
+        }
+        else if (op == 0xc6 || op == 0xc8 || op == 0xc9)            // pop {wR[ssss]-...}, {D[16+ssss]-...}, {D[ssss]-...}
+        {
+            *size += 8 * ((op2 & 0x0f) + 1);
+        }
+        else                                                        // Refuse to unwind, reserved or spare
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @brief This function adds the callees of a function to the call graph : the targets of
+ * its `BL <label>`, and of its `B` to another function (tail calls). Only targets that start
+ * a function are kept, so that a literal pool decoded as instructions rarely adds a call.
+ * A function whose code lowers sp by a register, or sets sp from another register than its
+ * frame pointer, allocates its frame dynamically and is flagged DEPTH_UNKNOWN.
+ * @param[in,out] graph           The call graph, holding the functions
+ * @param[in] index               The index of the function
+ * @return Nothing
+ */
+void AddCalls(callGraph_t* graph, uint32_t index)
+{
+    function_t* function = &graph->functions[index];
+    uint32_t first = 0;
+    uint32_t second = 0;
+    uint32_t target = 0;
+    uint32_t sign = 0;
+    uint32_t callee = 0;
+
+    (*function).first_call = graph->call_count;
+
+    for (uint32_t address = (*function).start; address + 2 <= (*function).end; )
+    {
+        first = ReadHalfword(address);
+        target = FUNCTION_NONE;
+
+        if ((first >> 11) >= 0x1d && address + 4 <= (*function).end)   // 32-bit instruction
+        {
+            second = ReadHalfword(address + 2);
+
+            // BL <label> (T1) and B.W <label> (T4) : S:I1:I2:imm10:imm11:'0', I = NOT(J XOR S)
+            if ((first & 0xf800) == 0xf000 && ((second & 0xd000) == 0xd000 || (second & 0xd000) == 0x9000))
+            {
+                sign = (first >> 10) & 0x1;
+                target = (sign ? 0xff000000u : 0)
+                    | ((((second >> 13) & 0x1) ^ sign ^ 0x1) << 23)
+                    | ((((second >> 11) & 0x1) ^ sign ^ 0x1) << 22)
+                    | ((first & 0x3ff) << 12)
+                    | ((second & 0x7ff) << 1);
+                target += address + 4;
+
+                // A branch within the function is not a call
+                if ((second & 0xd000) == 0x9000 && target >= (*function).start && target < (*function).end)
+                {
+                    target = FUNCTION_NONE;
+                }
+            }
+            // SUB SP, SP, <Rm> (T1) and ADD SP, SP, <Rm> (T3) : sp moved by a run-time amount
+            else if (((first & 0xffef) == 0xebad || (first & 0xffef) == 0xeb0d) && ((second >> 8) & 0xf) == 13)
+            {
+                (*function).flags |= DEPTH_UNKNOWN;
+            }
+            // MOV.W SP, <Rm> (T3) from another register than the frame pointer
+            else if ((first & 0xffef) == 0xea4f && (second & 0x7ff0) == 0x0d00 && (second & 0xf) != (*function).anchor)
+            {
+                (*function).flags |= DEPTH_UNKNOWN;
+            }
+
+            address += 4;
+        }
+        else
+        {
+            if ((first & 0xff87) == 0x4780)                                 // BLX <Rm>
+            {
+                (*function).flags |= DEPTH_INDIRECT;
+            }
+            else if ((first & 0xff87) == 0x4485)                            // ADD SP, <Rm>
+            {
+                (*function).flags |= DEPTH_UNKNOWN;
+            }
+            else if ((first & 0xff87) == 0x4685 && ((first >> 3) & 0xf) != (*function).anchor)
+            {
+                (*function).flags |= DEPTH_UNKNOWN;                         // MOV SP, <Rm>
+            }
+            else if ((first & 0xf800) == 0xe000)                            // B <label> (T2)
+            {
+                target = address + 4 + ((first & 0x400) ? 0xfffff000u : 0) + ((first & 0x7ff) << 1);
+
+                if (target >= (*function).start && target < (*function).end)
+                {
+                    target = FUNCTION_NONE;
+                }
+            }
+
+            address += 2;
+        }
+
+        callee = target == FUNCTION_NONE ? FUNCTION_NONE : FindFunction(graph, target);
+
+        if (callee != FUNCTION_NONE && graph->call_count < graph->call_capacity)
+        {
+            graph->calls[graph->call_count++] = callee;
+            (*function).call_count += 1;
+        }
+    }
+}
+
+/**
+ * @brief This function computes the worst-case depth of a function and of its callees, with
+ * a depth-first search of the call graph.
+ * @note A callee still being searched closes a cycle : it is not followed, and the functions
+ * reaching it are flagged DEPTH_RECURSIVE.
+ * @param[in,out] graph           The call graph
+ * @param[in] index               The index of the function
+ * @return Nothing
+ */
+void ComputeDepth(callGraph_t* graph, uint32_t index)
+{
+    function_t* function = &graph->functions[index];
+    function_t* callee = NULL;
+
+    if ((*function).state != STATE_NEW)
+    {
+        return;
+    }
+
+    (*function).state = STATE_ACTIVE;
+    (*function).depth = (*function).frame;
+
+    for (uint32_t call = 0; call < (*function).call_count; call++)
+    {
+        callee = &graph->functions[graph->calls[(*function).first_call + call]];
+
+        if ((*callee).state == STATE_ACTIVE)
+        {
+            (*function).flags |= DEPTH_RECURSIVE;
+            continue;
+        }
+
+        ComputeDepth(graph, graph->calls[(*function).first_call + call]);
+
+        (*function).flags |= (*callee).flags;
+
+        if ((*function).frame + (*callee).depth > (*function).depth)
+        {
+            (*function).depth = (*function).frame + (*callee).depth;
+            (*function).deepest = graph->calls[(*function).first_call + call];
+        }
+    }
+
+    (*function).state = STATE_DONE;
+}
+
+/**
+ * @brief This function finds the function starting at an address.
+ * @param[in] graph               The call graph
+ * @param[in] address             The address (Thumb bit cleared)
+ * @return The index of the function, or FUNCTION_NONE if no function starts there
+ */
+uint32_t FindFunction(const callGraph_t* graph, uint32_t address)
+{
+    uint32_t low = 0;
+    uint32_t high = graph->count;
+
+    while (low < high)
+    {
+        uint32_t middle = low + (high - low) / 2;
+
+        if (graph->functions[middle].start < address)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return low < graph->count && graph->functions[low].start == address ? low : FUNCTION_NONE;
+}
+
+/**
+ * @brief This function finds a function from its symbol name.
+ * @param[in] image               The image holding the symbols
+ * @param[in] graph               The call graph
+ * @param[in] name                The name of the function
+ * @return The index of the function, or FUNCTION_NONE
+ */
+uint32_t FindFunctionByName(const image_t* image, const callGraph_t* graph, const char* name)
+{
+    for (uint32_t symbol = 0; symbol < image->symbol_count; symbol++)
+    {
+        if (strcmp(image->symbols[symbol].name, name) == 0)
+        {
+            return FindFunction(graph, image->symbols[symbol].address);
+        }
+    }
+
+    return FUNCTION_NONE;
+}
+
+/**
+ * @brief This function prints the worst-case depth of an entry point and its path.
+ * @param[in] image               The image holding the symbols
+ * @param[in] graph               The call graph, with the depths computed
+ * @param[in] index               The index of the entry point
+ * @return Nothing
+ */
+void ReportDepth(const image_t* image, const callGraph_t* graph, uint32_t index)
+{
+    const function_t* function = &graph->functions[index];
+
+    printf("  %5u  %5u  %c%c%c  ", (*function).depth, (*function).frame,
+        ((*function).flags & DEPTH_UNKNOWN) ? '?' : '-',
+        ((*function).flags & DEPTH_INDIRECT) ? 'i' : '-',
+        ((*function).flags & DEPTH_RECURSIVE) ? 'r' : '-');
+
+    PrintFunction(image, (*function).start);
+
+    // The path ends on a leaf, or before a cycle
+    for (uint32_t frame = 0; (*function).deepest != FUNCTION_NONE && frame < graph->count; frame++)
+    {
+        function = &graph->functions[(*function).deepest];
+        printf(" > ");
+        PrintFunction(image, (*function).start);
+        printf(" (%u)", (*function).frame);
+    }
+
+    printf("\n");
+}
+
+/**
+ * @brief This function prints the symbol of a function, or its address.
+ * @param[in] image               The image holding the symbols
+ * @param[in] address             The start of the function
+ * @return Nothing
+ */
+void PrintFunction(const image_t* image, uint32_t address)
+{
+    uint32_t offset = 0;
+    const char* name = FindSymbol(image, address, &offset);
+
+    if (name != NULL && offset == 0)
+    {
+        printf("%s", name);
+    }
+    else
+    {
+        printf("0x%x", address);
+    }
+}
+
+/**
+ * @brief This function compares the static bound of the reset handler with the peak usage
+ * of the main stack measured on target.
+ * @param[in] image               The image holding the vector table
+ * @param[in] graph               The call graph, with the depths computed
+ * @param[in] path                The text trace holding the `*** stack 0 peak ...` lines
+ * @return 0 if the peak is within the bound, -1 otherwise or on error
+ */
+int CheckPeak(const image_t* image, const callGraph_t* graph, const char* path)
+{
+    FILE* file = fopen(path, "r");
+    char line[256] = {0};
+    uint32_t index = FindFunction(graph, HostReadWord(image->vectors_start + 4 * RESET_VECTOR) & ~0x1u);
+    uint32_t stack = 0;
+    uint32_t peak = 0;
+    uint32_t size = 0;
+    uint32_t max_peak = 0;
+    uint32_t stack_size = 0;
+    const function_t* reset = NULL;
+
+    if (file == NULL)
+    {
+        fprintf(stderr, "%s: can not be read\n", path);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        if (sscanf(line, "*** stack %u peak %u / %u", &stack, &peak, &size) == 3 && stack == 0 && peak >= max_peak)
+        {
+            max_peak = peak;
+            stack_size = size;
+        }
+    }
+
+    fclose(file);
+
+    if (index == FUNCTION_NONE || stack_size == 0)
+    {
+        fprintf(stderr, "%s: no reset handler in the unwind table or no main stack peak in the trace\n", path);
+        return -1;
+    }
+
+    reset = &graph->functions[index];
+
+    printf("Main stack : static bound %u bytes from ", (*reset).depth);
+    PrintFunction(image, (*reset).start);
+    printf(", runtime peak %u bytes, watched %u bytes\n", max_peak, stack_size);
+
+    if ((*reset).flags)
+    {
+        printf("The bound is not proven :%s%s%s\n",
+            ((*reset).flags & DEPTH_UNKNOWN) ? " unknown frame" : "",
+            ((*reset).flags & DEPTH_INDIRECT) ? " indirect call" : "",
+            ((*reset).flags & DEPTH_RECURSIVE) ? " recursion" : "");
+    }
+
+    if (max_peak > (*reset).depth)
+    {
+        printf("The runtime peak exceeds the static bound by %u bytes : a path or an exception frame is missing\n",
+            max_peak - (*reset).depth);
+        return -1;
+    }
+
+    printf("The runtime peak is within the static bound (%u bytes of margin)\n", (*reset).depth - max_peak);
+
+    return 0;
+}
+
+/**
+ * @brief This function counts the bits set in a register mask.
+ * @param[in] mask                The mask
+ * @return The number of bits set
+ */
+uint32_t PopCount(uint32_t mask)
+{
+    uint32_t count = 0;
+
+    for (; mask != 0; mask &= mask - 1)
+    {
+        count++;
+    }
+
+    return count;
+}
+
+/**
+ * @brief This function reads a target halfword.
+ * @param[in] address             The target address (halfword aligned)
+ * @return The halfword, or 0 if the address is not in the image
+ */
+uint32_t ReadHalfword(uint32_t address)
+{
+    return (HostReadWord(address & ~0x3u) >> ((address & 0x2) * 8)) & 0xffff;
+}
+
+/**
+ * @brief This function releases a call graph.
+ * @param[in,out] graph           The call graph to release
+ * @return Nothing
+ */
+void FreeCallGraph(callGraph_t* graph)
+{
+    free(graph->functions);
+    free(graph->calls);
+    memset(graph, 0, sizeof(*graph));
+}
@@ -0,0 +1,1299 @@
+/**
+ * @file    unwindgen.c
+ * @author  Théo Bessel
+ * @brief   Generator of the index of the unwind table
+ *
+ * Usage : unwindgen <target.elf> <unwind_index.c> pages [<page_shift>]
+ *         unwindgen <target.elf> <unwind_index.c> eytzinger
+ *         unwindgen <target.elf> <unwind_index.c> pool
+ *         unwindgen <target.elf> <unwind_calls.c> calls
+ *         unwindgen <target.elf> --verify
+ *         unwindgen <target.elf> --bench <iterations>
+ *         unwindgen --layouts <lookups>
+ *
+ * The index is generated from a first link of the target, then compiled and linked again in
+ * the `.unwind_index` section, which follows the unwind table so that no code moves (see
+ * `UNWIND_INDEX` in gen/config.mk). Three layouts are available :
+ *   - pages : each code page (4 KiB by default) is mapped to the `.ARM.exidx` entries covering
+ *     it, so that FindExidxEntry only searches a few entries instead of the whole table.
+ *   - eytzinger : the function addresses are stored in BFS order of the implicit search tree,
+ *     so that the search is a single load and comparison per level, without branch on the
+ *     result, and its first levels share the same cache lines.
+ *   - pool : identical unwind programs (inline words or `.ARM.extab` instructions) are stored
+ *     once, and adjacent functions sharing a program are collapsed in a single range, which
+ *     replaces `.ARM.exidx` for the unwinder with a smaller table.
+ * The call sites table (`.unwind_calls`, see `UNWIND_CALLS`) is a minimal perfect hash of the
+ * return addresses of every `BL` / `BLX` of `.text`, mapped to the entry of their function :
+ * return addresses are found in constant time, and any other value read as a return address
+ * stops the walk.
+ * `--verify` checks that the linked tables match the unwind table of the image, `--bench`
+ * times lookups with and without them, `--layouts` compares a binary search with an
+ * Eytzinger search (with prefetch, as used by FindSymbol) over synthetic tables of 1k to 1M
+ * functions.
+ *
+ * @copyright Copyright (c) Théo Bessel 2024
+ */
+
+/******************************* Include Files *******************************/
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stacktrace.h"
+#include "image.h"
+
+/***************************** Macros Definitions ****************************/
+
+// CantUnwind symbol
+#define EXIDX_CANTUNWIND 0x1
+
+// Default page size : 4 KiB
+#define DEFAULT_PAGE_SHIFT 12u
+
+// Entries of the index are stored on 16 bits
+#define MAX_ENTRIES 0x10000u
+
+// Table generated instead of an index (`calls`)
+#define CALL_SITES_TABLE 0x100u
+
+// Call sites per bucket of the perfect hash, and seeds tried before giving up
+#define CALL_SITES_BUCKET_SIZE 4u
+#define CALL_SITES_ATTEMPTS 32u
+
+// Displacements are stored on 16 bits
+#define MAX_DISPLACEMENT 0xffffu
+
+// Table sizes compared by --layouts
+#define LAYOUTS_MIN_SIZE 1000u
+#define LAYOUTS_MAX_SIZE 1000000u
+
+/***************************** Types Definitions *****************************/
+
+/**
+ * @brief Structure to store an index built on host.
+ */
+typedef struct
+{
+    unwindIndexHeader_t header;         /**< Header, as linked on target.    */
+    uint32_t* keys;                     /**< Eytzinger keys, range starts.   */
+    uint32_t* pool;                     /**< Pool : `pool_count` programs.   */
+    uint16_t* entries;                  /**< Entries or range programs.      */
+} unwindIndex_t;
+
+/**
+ * @brief Structure to store a call sites table built on host.
+ */
+typedef struct
+{
+    callSitesHeader_t header;           /**< Header, as linked on target.    */
+    uint32_t* keys;                     /**< Return address of each slot.    */
+    uint16_t* displacements;            /**< Displacement of each bucket.    */
+    uint16_t* entries;                  /**< Entry of each slot.             */
+} callSites_t;
+
+/*************************** Functions Declarations **************************/
+
+int BuildIndex(const image_t* image, uint32_t layout, uint32_t page_shift, unwindIndex_t* index);
+int BuildPool(const image_t* image, unwindIndex_t* index);
+uint32_t GetTableWords(const image_t* image, uint32_t table, uint32_t* personality);
+int SameTable(const image_t* image, uint32_t first, uint32_t second);
+int WriteIndex(const unwindIndex_t* index, const char* path, const char* elf_path);
+void WriteWords(FILE* file, const uint32_t* words, uint32_t count);
+void WriteHalfwords(FILE* file, const uint16_t* halfwords, uint32_t count);
+int VerifyIndex(const image_t* image);
+void ReportIndex(const image_t* image, const unwindIndex_t* index);
+void Benchmark(const image_t* image, uint32_t iterations);
+void CompareLayouts(uint32_t lookups);
+int BuildCallSites(const image_t* image, callSites_t* calls);
+int PlaceCallSites(callSites_t* calls, const uint32_t* sites, const uint16_t* entries, uint8_t* used, uint32_t* buckets);
+uint32_t EnumerateCallSites(const image_t* image, uint32_t** sites, uint16_t** entries);
+int WriteCallSites(const callSites_t* calls, const char* path, const char* elf_path);
+int VerifyCallSites(const image_t* image);
+void BenchmarkCallSites(const image_t* image, uint32_t iterations);
+uint32_t GetIndexSize(const unwindIndex_t* index);
+uint32_t GetIndexLength(const unwindIndex_t* index);
+uint32_t Log2Ceil(uint32_t value);
+double GetSeconds(const struct timespec* start);
+void FreeIndex(unwindIndex_t* index);
+void FreeCallSites(callSites_t* calls);
+uint32_t ReadHalfword(uint32_t address);
+int CompareAddresses(const void* a, const void* b);
+
+/*************************** Functions Definitions ***************************/
+
+int main(int argc, char** argv)
+{
+    image_t image = {0};
+    unwindIndex_t index = {0};
+    callSites_t calls = {0};
+    uint32_t layout = 0;
+    int status = EXIT_FAILURE;
+
+    if (argc >= 4 && strcmp(argv[3], "pages") == 0 && argc <= 5)
+    {
+        layout = UNWIND_INDEX_PAGES;
+    }
+    else if (argc == 4 && strcmp(argv[3], "eytzinger") == 0)
+    {
+        layout = UNWIND_INDEX_EYTZINGER;
+    }
+    else if (argc == 4 && strcmp(argv[3], "pool") == 0)
+    {
+        layout = UNWIND_INDEX_POOL;
+    }
+    else if (argc == 4 && strcmp(argv[3], "calls") == 0)
+    {
+        layout = CALL_SITES_TABLE;
+    }
+
+    if (argc == 3 && strcmp(argv[1], "--layouts") == 0)
+    {
+        CompareLayouts(strtoul(argv[2], NULL, 0));
+        return EXIT_SUCCESS;
+    }
+
+    if (
+        layout == 0
+        && !(argc == 3 && strcmp(argv[2], "--verify") == 0)
+        && !(argc == 4 && strcmp(argv[2], "--bench") == 0)
+    )
+    {
+        fprintf(stderr, "Usage: %s <target.elf> <unwind_index.c> pages [<page_shift>]\n", argv[0]);
+        fprintf(stderr, "       %s <target.elf> <unwind_index.c> eytzinger\n", argv[0]);
+        fprintf(stderr, "       %s <target.elf> <unwind_index.c> pool\n", argv[0]);
+        fprintf(stderr, "       %s <target.elf> <unwind_calls.c> calls\n", argv[0]);
+        fprintf(stderr, "       %s <target.elf> --verify\n", argv[0]);
+        fprintf(stderr, "       %s <target.elf> --bench <iterations>\n", argv[0]);
+        fprintf(stderr, "       %s --layouts <lookups>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (LoadImage(&image, argv[1]) != 0)
+    {
+        return EXIT_FAILURE;
+    }
+
+    SetHostImage(&image);
+
+    if (strcmp(argv[2], "--verify") == 0)
+    {
+        status = VerifyIndex(&image) == 0 && VerifyCallSites(&image) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    else if (strcmp(argv[2], "--bench") == 0)
+    {
+        Benchmark(&image, strtoul(argv[3], NULL, 0));
+        BenchmarkCallSites(&image, strtoul(argv[3], NULL, 0));
+        status = EXIT_SUCCESS;
+    }
+    else if (layout == CALL_SITES_TABLE)
+    {
+        if (BuildCallSites(&image, &calls) == 0)
+        {
+            status = WriteCallSites(&calls, argv[2], argv[1]) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    else if (BuildIndex(&image, layout, argc == 5 ? strtoul(argv[4], NULL, 0) : DEFAULT_PAGE_SHIFT, &index) == 0)
+    {
+        ReportIndex(&image, &index);
+        status = WriteIndex(&index, argv[2], argv[1]) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    FreeIndex(&index);
+    FreeCallSites(&calls);
+    FreeImage(&image);
+
+    return status;
+}
+
+/**
+ * @brief This function builds an index of the unwind table of an image.
+ * @param[in] image               The image
+ * @param[in] layout              UNWIND_INDEX_PAGES, UNWIND_INDEX_EYTZINGER or UNWIND_INDEX_POOL
+ * @param[in] page_shift          Log2 of the page size (pages only)
+ * @param[out] index              The index (to free with FreeIndex)
+ * @return 0 on success, -1 if the table can not be indexed
+ */
+int BuildIndex(const image_t* image, uint32_t layout, uint32_t page_shift, unwindIndex_t* index)
+{
+    uint32_t entries_count = (image->exidx_end - image->exidx_start) / 8;
+    uint32_t* sorted = NULL;
+    uint32_t* order = NULL;
+    uint32_t first_fn = 0;
+    uint32_t last_fn = 0;
+    uint32_t entry = 0;
+
+    if (
+        entries_count == 0 || entries_count > MAX_ENTRIES
+        || (layout != UNWIND_INDEX_PAGES && layout != UNWIND_INDEX_EYTZINGER && layout != UNWIND_INDEX_POOL)
+        || (layout == UNWIND_INDEX_PAGES && (page_shift < 2 || page_shift > 24))
+    )
+    {
+        fprintf(stderr, "Can not index %u unwind entries with %u bits pages\n", entries_count, page_shift);
+        return -1;
+    }
+
+    first_fn = GetExidxEntry(image->exidx_start, 0).decoded_fn;
+    last_fn = GetExidxEntry(image->exidx_start, 8 * (entries_count - 1)).decoded_fn;
+
+    index->header.layout = layout;
+
+    if (layout == UNWIND_INDEX_POOL)
+    {
+        return BuildPool(image, index);
+    }
+
+    if (layout == UNWIND_INDEX_EYTZINGER)
+    {
+        index->header.count = entries_count;
+        index->keys = calloc(entries_count + 1, sizeof(uint32_t));
+        index->entries = calloc(entries_count + 1, sizeof(uint16_t));
+        sorted = calloc(entries_count, sizeof(uint32_t));
+        order = calloc(entries_count + 1, sizeof(uint32_t));
+
+        if (index->keys == NULL || index->entries == NULL || sorted == NULL || order == NULL)
+        {
+            free(sorted);
+            free(order);
+            return -1;
+        }
+
+        // Entries are sorted by function address
+        for (entry = 0; entry < entries_count; entry++)
+        {
+            sorted[entry] = GetExidxEntry(image->exidx_start, 8 * entry).decoded_fn;
+        }
+
+        BuildEytzinger(sorted, entries_count, index->keys, order, 0, 1);
+
+        for (uint32_t node = 1; node <= entries_count; node++)
+        {
+            index->entries[node] = order[node];
+        }
+
+        free(sorted);
+        free(order);
+
+        return 0;
+    }
+
+    index->header.base = first_fn & ~((1u << page_shift) - 1);
+    index->header.page_shift = page_shift;
+    index->header.count = ((last_fn - index->header.base) >> page_shift) + 1;
+    index->entries = calloc(index->header.count + 1, sizeof(uint16_t));
+
+    if (index->entries == NULL)
+    {
+        return -1;
+    }
+
+    // Entry containing the start of each page (entries are sorted by function address)
+    for (uint32_t page = 0; page <= index->header.count; page++)
+    {
+        uint32_t start = index->header.base + (page << page_shift);
+
+        while (
+            entry + 1 < entries_count
+            && GetExidxEntry(image->exidx_start, 8 * (entry + 1)).decoded_fn <= start
+        )
+        {
+            entry++;
+        }
+
+        index->entries[page] = entry;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief This function builds the program pool of the unwind table : each entry is reduced to
+ * its program (EXIDX_CANTUNWIND, its inline word, or the offset of the first `.ARM.extab`
+ * table entry with the same unwinding instructions), identical programs are stored once and
+ * adjacent functions with the same program are collapsed in a single range.
+ * @param[in] image               The image
+ * @param[in,out] index           The index (layout set)
+ * @return 0 on success, -1 on error
+ */
+int BuildPool(const image_t* image, unwindIndex_t* index)
+{
+    uint32_t entries_count = (image->exidx_end - image->exidx_start) / 8;
+    uint32_t* programs = calloc(entries_count, sizeof(uint32_t));
+    uint32_t* tables = calloc(entries_count, sizeof(uint32_t));
+    uint32_t table_count = 0;
+
+    index->keys = calloc(entries_count, sizeof(uint32_t));
+    index->pool = calloc(entries_count, sizeof(uint32_t));
+    index->entries = calloc(entries_count, sizeof(uint16_t));
+
+    if (programs == NULL || tables == NULL || index->keys == NULL || index->pool == NULL || index->entries == NULL)
+    {
+        free(programs);
+        free(tables);
+        return -1;
+    }
+
+    for (uint32_t entry = 0; entry < entries_count; entry++)
+    {
+        exidxEntry_t exidx_entry = GetExidxEntry(image->exidx_start, 8 * entry);
+        uint32_t table = 0;
+
+        programs[entry] = exidx_entry.exidx_entry;
+
+        if (exidx_entry.exidx_entry & 0x80000000 || exidx_entry.exidx_entry == EXIDX_CANTUNWIND)
+        {
+            continue;
+        }
+
+        // A table entry outside of `.ARM.extab` stops the unwind, as EXIDX_CANTUNWIND does
+        if (GetTableWords(image, exidx_entry.decoded_entry, NULL) == 0)
+        {
+            programs[entry] = EXIDX_CANTUNWIND;
+            continue;
+        }
+
+        for (table = 0; table < table_count && !SameTable(image, tables[table], exidx_entry.decoded_entry); table++)
+        {
+        }
+
+        if (table == table_count)
+        {
+            tables[table_count++] = exidx_entry.decoded_entry;
+        }
+
+        programs[entry] = tables[table] - image->extab_start;
+    }
+
+    // Distinct programs, sorted so that each range finds its program with a binary search
+    memcpy(index->pool, programs, entries_count * sizeof(uint32_t));
+    qsort(index->pool, entries_count, sizeof(uint32_t), CompareAddresses);
+
+    for (uint32_t program = 0; program < entries_count; program++)
+    {
+        if (index->header.pool_count == 0 || index->pool[index->header.pool_count - 1] != index->pool[program])
+        {
+            index->pool[index->header.pool_count++] = index->pool[program];
+        }
+    }
+
+    for (uint32_t entry = 0; entry < entries_count; entry++)
+    {
+        uint32_t* program = bsearch(&programs[entry], index->pool, index->header.pool_count, sizeof(uint32_t), CompareAddresses);
+
+        if (index->header.count == 0 || index->entries[index->header.count - 1] != program - index->pool)
+        {
+            index->keys[index->header.count] = GetExidxEntry(image->exidx_start, 8 * entry).decoded_fn;
+            index->entries[index->header.count] = program - index->pool;
+            index->header.count += 1;
+        }
+    }
+
+    free(programs);
+    free(tables);
+
+    return 0;
+}
+
+/**
+ * @brief This function counts the words holding the unwinding instructions of a `.ARM.extab`
+ * table entry, as UnwindNextFrame reads them.
+ * @param[in] image               The image
+ * @param[in] table               The address of the table entry
+ * @param[out] personality        The personality routine of a generic model entry, 0 for a
+ * compact model entry (may be NULL)
+ * @return The number of words from the start of the entry, 0 if the entry is not valid
+ */
+uint32_t GetTableWords(const image_t* image, uint32_t table, uint32_t* personality)
+{
+    uint32_t words = 0;
+    uint32_t word = 0;
+
+    if (table < image->extab_start || table >= image->extab_end || (table & 0x3))
+    {
+        return 0;
+    }
+
+    word = HostReadWord(table);
+
+    if (word & 0x80000000)                          // Compact model
+    {
+        words = GetEntryWordCount(word);
+    }
+    else if (image->extab_end - table >= 8)         // Generic model, after the personality routine
+    {
+        words = 2 + (HostReadWord(table + 4) >> 24);
+    }
+
+    if (personality != NULL)
+    {
+        *personality = word & 0x80000000 ? 0 : DecodePrel31(word, table);
+    }
+
+    return (image->extab_end - table) / 4 >= words ? words : 0;
+}
+
+/**
+ * @brief This function compares the unwinding instructions of two `.ARM.extab` table entries
+ * (the language specific data is not compared, the unwinder does not read it).
+ * @param[in] image               The image
+ * @param[in] first               The address of the first table entry
+ * @param[in] second              The address of the second table entry
+ * @return 1 if both entries unwind frames the same way, 0 otherwise
+ */
+int SameTable(const image_t* image, uint32_t first, uint32_t second)
+{
+    uint32_t first_personality = 0;
+    uint32_t second_personality = 0;
+    uint32_t words = GetTableWords(image, first, &first_personality);
+
+    if (words == 0 || words != GetTableWords(image, second, &second_personality) || first_personality != second_personality)
+    {
+        return 0;
+    }
+
+    // The first word of a generic model entry is a prel31 offset, compared once decoded
+    for (uint32_t word = first_personality != 0 ? 1 : 0; word < words; word++)
+    {
+        if (HostReadWord(first + 4 * word) != HostReadWord(second + 4 * word))
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @brief This function writes an index as a C file to link in the target.
+ * @param[in] index               The index
+ * @param[in] path                The path of the C file
+ * @param[in] elf_path            The path of the indexed image
+ * @return 0 on success, -1 on error
+ */
+int WriteIndex(const unwindIndex_t* index, const char* path, const char* elf_path)
+{
+    const char* names[] = { "", "UNWIND_INDEX_PAGES", "UNWIND_INDEX_EYTZINGER", "UNWIND_INDEX_POOL" };
+    const char* titles[] = { "", "Page index", "Eytzinger index", "Program pool" };
+    uint32_t length = GetIndexLength(index);
+    FILE* file = fopen(path, "w");
+
+    if (file == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+
+    fprintf(file, "/**\n");
+    fprintf(file, " * @file    %s\n", strrchr(path, '/') ? strrchr(path, '/') + 1 : path);
+    fprintf(file, " * @brief   %s of `.ARM.exidx` generated by unwindgen from %s\n",
+        titles[index->header.layout], elf_path);
+    fprintf(file, " */\n\n");
+    fprintf(file, "#include \"stacktrace.h\"\n\n");
+    fprintf(file, "const struct\n{\n");
+    fprintf(file, "    unwindIndexHeader_t header;\n");
+
+    if (index->keys != NULL)
+    {
+        fprintf(file, "    uint32_t keys[%u];\n", length);
+    }
+
+    if (index->pool != NULL)
+    {
+        fprintf(file, "    uint32_t pool[%u];\n", index->header.pool_count);
+    }
+
+    fprintf(file, "    uint16_t entries[%u];\n", length);
+    fprintf(file, "} unwind_index __attribute__((section(\".unwind_index\"), used)) = {\n");
+    fprintf(file, "    { %s, 0x%08x, %u, %u, %u },\n", names[index->header.layout],
+        index->header.base, index->header.page_shift, index->header.count, index->header.pool_count);
+
+    if (index->keys != NULL)
+    {
+        WriteWords(file, index->keys, length);
+    }
+
+    if (index->pool != NULL)
+    {
+        WriteWords(file, index->pool, index->header.pool_count);
+    }
+
+    WriteHalfwords(file, index->entries, length);
+    fprintf(file, "};\n");
+
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+/**
+ * @brief This function writes the initializer of an array of words.
+ * @param[in] file                The C file
+ * @param[in] words               The words
+ * @param[in] count               The number of words
+ * @return Nothing
+ */
+void WriteWords(FILE* file, const uint32_t* words, uint32_t count)
+{
+    fprintf(file, "    {");
+
+    for (uint32_t word = 0; word < count; word++)
+    {
+        fprintf(file, "%s0x%08x%s", word % 8 == 0 ? "\n        " : " ", words[word], word + 1 < count ? "," : "");
+    }
+
+    fprintf(file, "\n    },\n");
+}
+
+/**
+ * @brief This function writes the initializer of an array of halfwords.
+ * @param[in] file                The C file
+ * @param[in] halfwords           The halfwords
+ * @param[in] count               The number of halfwords
+ * @return Nothing
+ */
+void WriteHalfwords(FILE* file, const uint16_t* halfwords, uint32_t count)
+{
+    fprintf(file, "    {");
+
+    for (uint32_t halfword = 0; halfword < count; halfword++)
+    {
+        fprintf(file, "%s%u%s", halfword % 16 == 0 ? "\n        " : " ", halfwords[halfword],
+            halfword + 1 < count ? "," : "");
+    }
+
+    fprintf(file, "\n    },\n");
+}
+
+/**
+ * @brief This function checks that the linked index matches the unwind table.
+ * @param[in] image               The image
+ * @return 0 if the index matches (or if there is no index), -1 otherwise
+ */
+int VerifyIndex(const image_t* image)
+{
+    unwindIndex_t index = {0};
+    uint32_t address = image->unwind_index_start;
+    uint32_t size = image->unwind_index_end - image->unwind_index_start;
+    uint32_t keys = address + sizeof(unwindIndexHeader_t);
+    uint32_t pool = 0;
+    uint32_t entries = 0;
+    uint32_t length = 0;
+    int status = 0;
+
+    if (size == 0)
+    {
+        printf("No unwind index linked\n");
+        return 0;
+    }
+
+    if (
+        size < sizeof(unwindIndexHeader_t)
+        || BuildIndex(
+            image, HostReadWord(address + offsetof(unwindIndexHeader_t, layout)),
+            HostReadWord(address + offsetof(unwindIndexHeader_t, page_shift)), &index
+        ) != 0
+        || size < GetIndexSize(&index)
+        || HostReadWord(address + offsetof(unwindIndexHeader_t, base)) != index.header.base
+        || HostReadWord(address + offsetof(unwindIndexHeader_t, count)) != index.header.count
+        || HostReadWord(address + offsetof(unwindIndexHeader_t, pool_count)) != index.header.pool_count
+    )
+    {
+        status = -1;
+    }
+
+    length = GetIndexLength(&index);
+    pool = keys + (index.keys != NULL ? 4 * length : 0);
+    entries = pool + 4 * index.header.pool_count;
+
+    for (uint32_t node = 0; status == 0 && node < length; node++)
+    {
+        if (
+            ReadHalfword(entries + 2 * node) != index.entries[node]
+            || (index.keys != NULL && HostReadWord(keys + 4 * node) != index.keys[node])
+        )
+        {
+            status = -1;
+        }
+    }
+
+    for (uint32_t program = 0; status == 0 && program < index.header.pool_count; program++)
+    {
+        if (HostReadWord(pool + 4 * program) != index.pool[program])
+        {
+            status = -1;
+        }
+    }
+
+    printf(status == 0 ? "Unwind index matches the unwind table\n" : "Unwind index does not match the unwind table\n");
+    FreeIndex(&index);
+
+    return status;
+}
+
+/**
+ * @brief This function builds the call sites table of an image : a hash and displace minimal
+ * perfect hash, whose buckets are placed from the largest, each with the first displacement
+ * sending all its call sites to free slots. Other seeds and more buckets are tried on failure.
+ * @param[in] image               The image
+ * @param[out] calls              The table (to free with FreeCallSites)
+ * @return 0 on success, -1 if the call sites can not be hashed
+ */
+int BuildCallSites(const image_t* image, callSites_t* calls)
+{
+    uint32_t* sites = NULL;
+    uint16_t* entries = NULL;
+    uint32_t count = EnumerateCallSites(image, &sites, &entries);
+    uint8_t* used = calloc(count + 1, sizeof(uint8_t));
+    uint32_t* buckets = calloc(count + 1, sizeof(uint32_t));
+    int status = -1;
+
+    calls->header.count = count;
+    calls->keys = calloc(count + 1, sizeof(uint32_t));
+    calls->entries = calloc(count + 1, sizeof(uint16_t));
+    calls->displacements = calloc(count + 1, sizeof(uint16_t));
+
+    if (count == 0 || count > MAX_ENTRIES)
+    {
+        fprintf(stderr, "Can not hash %u call sites\n", count);
+    }
+    else if (used != NULL && buckets != NULL && calls->keys != NULL && calls->entries != NULL && calls->displacements != NULL)
+    {
+        for (uint32_t attempt = 0; attempt < CALL_SITES_ATTEMPTS && status != 0; attempt++)
+        {
+            calls->header.seed = 0x2545f491u * (attempt + 1);
+            calls->header.bucket_count = count / CALL_SITES_BUCKET_SIZE + 1 + attempt * (count / 32);
+
+            if (calls->header.bucket_count > count)
+            {
+                calls->header.bucket_count = count;
+            }
+
+            status = PlaceCallSites(calls, sites, entries, used, buckets);
+        }
+
+        if (status == 0)
+        {
+            printf("Call sites    : %u return addresses in %u buckets (%u bytes), 2 hashes and 3 loads per lookup\n",
+                count, calls->header.bucket_count,
+                (uint32_t) (sizeof(callSitesHeader_t) + 6 * count + 2 * calls->header.bucket_count));
+        }
+        else
+        {
+            fprintf(stderr, "Can not find a perfect hash of %u call sites\n", count);
+        }
+    }
+
+    free(sites);
+    free(entries);
+    free(used);
+    free(buckets);
+
+    return status;
+}
+
+/**
+ * @brief This function places the call sites in the slots of the table with its seed and its
+ * number of buckets.
+ * @param[in,out] calls           The table
+ * @param[in] sites               The sorted return addresses
+ * @param[in] entries             The entry of each return address
+ * @param[out] used               Scratch buffer of `count` slot flags
+ * @param[out] buckets            Scratch buffer of `count` call sites
+ * @return 0 on success, -1 if a bucket has no valid displacement
+ */
+int PlaceCallSites(callSites_t* calls, const uint32_t* sites, const uint16_t* entries, uint8_t* used, uint32_t* buckets)
+{
+    uint32_t count = calls->header.count;
+    uint32_t bucket_count = calls->header.bucket_count;
+    uint32_t* starts = calloc(bucket_count + 2, sizeof(uint32_t));
+    uint32_t* order = calloc(bucket_count, sizeof(uint32_t));
+    uint32_t max_size = 0;
+    uint32_t placed = 0;
+
+    if (starts == NULL || order == NULL)
+    {
+        free(starts);
+        free(order);
+        return -1;
+    }
+
+    memset(used, 0, count);
+    memset(calls->displacements, 0, bucket_count * sizeof(uint16_t));
+
+    // Call sites grouped by bucket (counting sort)
+    for (uint32_t site = 0; site < count; site++)
+    {
+        starts[HashCallSite(sites[site], calls->header.seed, bucket_count) + 2] += 1;
+    }
+
+    for (uint32_t bucket = 0; bucket < bucket_count; bucket++)
+    {
+        max_size = starts[bucket + 2] > max_size ? starts[bucket + 2] : max_size;
+        starts[bucket + 2] += starts[bucket + 1];
+    }
+
+    for (uint32_t site = 0; site < count; site++)
+    {
+        buckets[starts[HashCallSite(sites[site], calls->header.seed, bucket_count) + 1]++] = site;
+    }
+
+    // Buckets ordered from the largest, the smaller ones fill the remaining slots
+    for (uint32_t size = max_size; size > 0; size--)
+    {
+        for (uint32_t bucket = 0; bucket < bucket_count; bucket++)
+        {
+            if (starts[bucket + 1] - starts[bucket] == size)
+            {
+                order[placed++] = bucket;
+            }
+        }
+    }
+
+    for (uint32_t position = 0; position < placed; position++)
+    {
+        uint32_t first = starts[order[position]];
+        uint32_t last = starts[order[position] + 1];
+        uint32_t displacement = 0;
+        uint32_t site = first;
+
+        for (displacement = 0; displacement <= MAX_DISPLACEMENT && site < last; displacement++)
+        {
+            uint32_t seed = CALL_SITES_SLOT_SEED(calls->header.seed, displacement);
+
+            // Slots are taken one call site after the other, and released if one collides
+            for (site = first; site < last && !used[HashCallSite(sites[buckets[site]], seed, count)]; site++)
+            {
+                used[HashCallSite(sites[buckets[site]], seed, count)] = 1;
+            }
+
+            if (site < last)
+            {
+                for (uint32_t taken = first; taken < site; taken++)
+                {
+                    used[HashCallSite(sites[buckets[taken]], seed, count)] = 0;
+                }
+            }
+            else
+            {
+                calls->displacements[order[position]] = displacement;
+
+                for (site = first; site < last; site++)
+                {
+                    calls->keys[HashCallSite(sites[buckets[site]], seed, count)] = sites[buckets[site]];
+                    calls->entries[HashCallSite(sites[buckets[site]], seed, count)] = entries[buckets[site]];
+                }
+            }
+        }
+
+        if (site < last)
+        {
+            free(starts);
+            free(order);
+            return -1;
+        }
+    }
+
+    free(starts);
+    free(order);
+
+    return 0;
+}
+
+/**
+ * @brief This function lists the return addresses of the calls of `.text` : the address
+ * following each `BL` (32 bits) and `BLX <Rm>` (16 bits). Every halfword is decoded, so that
+ * literal pools or misaligned decodes never hide a call : a few values may be kept that are
+ * not calls, but no return address is missed.
+ * @param[in] image               The image
+ * @param[out] sites              The sorted return addresses within a function of `.ARM.exidx` (to free)
+ * @param[out] entries            The entry of each return address (to free)
+ * @return The number of return addresses
+ */
+uint32_t EnumerateCallSites(const image_t* image, uint32_t** sites, uint16_t** entries)
+{
+    uint32_t entries_count = (image->exidx_end - image->exidx_start) / 8;
+    uint32_t count = 0;
+    uint32_t unique = 0;
+    uint32_t entry = 0;
+
+    *sites = calloc((image->text_end - image->text_start) / 2 + 1, sizeof(uint32_t));
+    *entries = calloc((image->text_end - image->text_start) / 2 + 1, sizeof(uint16_t));
+
+    if (*sites == NULL || *entries == NULL || entries_count == 0)
+    {
+        return 0;
+    }
+
+    for (uint32_t address = image->text_start & ~0x1u; address + 2 <= image->text_end; address += 2)
+    {
+        uint32_t first = ReadHalfword(address);
+        uint32_t second = address + 4 <= image->text_end ? ReadHalfword(address + 2) : 0;
+
+        if ((first & 0xf800) == 0xf000 && (second & 0xd000) == 0xd000)      // BL <label>
+        {
+            (*sites)[count++] = address + 4;
+        }
+        else if ((first & 0xff87) == 0x4780)                                // BLX <Rm>
+        {
+            (*sites)[count++] = address + 2;
+        }
+    }
+
+    qsort(*sites, count, sizeof(uint32_t), CompareAddresses);
+
+    // Unique return addresses, with the entry of the function containing their call
+    for (uint32_t site = 0; site < count; site++)
+    {
+        while (
+            entry + 1 < entries_count
+            && GetExidxEntry(image->exidx_start, 8 * (entry + 1)).decoded_fn <= (*sites)[site] - 1
+        )
+        {
+            entry++;
+        }
+
+        if (
+            (unique == 0 || (*sites)[unique - 1] != (*sites)[site])
+            && GetExidxEntry(image->exidx_start, 8 * entry).decoded_fn <= (*sites)[site] - 1
+        )
+        {
+            (*sites)[unique] = (*sites)[site];
+            (*entries)[unique] = entry;
+            unique++;
+        }
+    }
+
+    return unique;
+}
+
+/**
+ * @brief This function writes the call sites table as a C file to link in the target.
+ * @param[in] calls               The table
+ * @param[in] path                The path of the C file
+ * @param[in] elf_path            The path of the image
+ * @return 0 on success, -1 on error
+ */
+int WriteCallSites(const callSites_t* calls, const char* path, const char* elf_path)
+{
+    uint32_t count = calls->header.count;
+    uint32_t bucket_count = calls->header.bucket_count;
+    FILE* file = fopen(path, "w");
+
+    if (file == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+
+    fprintf(file, "/**\n");
+    fprintf(file, " * @file    %s\n", strrchr(path, '/') ? strrchr(path, '/') + 1 : path);
+    fprintf(file, " * @brief   Call sites table generated by unwindgen from %s\n", elf_path);
+    fprintf(file, " */\n\n");
+    fprintf(file, "#include \"stacktrace.h\"\n\n");
+    fprintf(file, "const struct\n{\n");
+    fprintf(file, "    callSitesHeader_t header;\n");
+    fprintf(file, "    uint32_t keys[%u];\n", count);
+    fprintf(file, "    uint16_t displacements[%u];\n", bucket_count);
+    fprintf(file, "    uint16_t entries[%u];\n", count);
+    fprintf(file, "} unwind_calls __attribute__((section(\".unwind_calls\"), used)) = {\n");
+    fprintf(file, "    { 0x%08x, %u, %u },\n", calls->header.seed, bucket_count, count);
+    WriteWords(file, calls->keys, count);
+    WriteHalfwords(file, calls->displacements, bucket_count);
+    WriteHalfwords(file, calls->entries, count);
+    fprintf(file, "};\n");
+
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+/**
+ * @brief This function checks that every call site of the image is found in the linked
+ * call sites table, with the entry of its function.
+ * @param[in] image               The image
+ * @return 0 if the table matches (or if there is no table), -1 otherwise
+ */
+int VerifyCallSites(const image_t* image)
+{
+    uint32_t* sites = NULL;
+    uint16_t* entries = NULL;
+    uint32_t count = 0;
+    int status = 0;
+
+    if (image->unwind_calls_end == image->unwind_calls_start)
+    {
+        printf("No call sites table linked\n");
+        return 0;
+    }
+
+    count = EnumerateCallSites(image, &sites, &entries);
+
+    if (
+        count == 0
+        || image->unwind_calls_end - image->unwind_calls_start < sizeof(callSitesHeader_t)
+        || HostReadWord(image->unwind_calls_start + offsetof(callSitesHeader_t, count)) != count
+    )
+    {
+        status = -1;
+    }
+
+    for (uint32_t site = 0; status == 0 && site < count; site++)
+    {
+        if (FindCallSite(sites[site]) != entries[site])
+        {
+            status = -1;
+        }
+    }
+
+    printf(status == 0 ? "Call sites table matches the image\n" : "Call sites table does not match the image\n");
+    free(sites);
+    free(entries);
+
+    return status;
+}
+
+/**
+ * @brief This function times the lookup of every call site in the linked call sites table,
+ * against FindExidxEntry on the call instruction.
+ * @param[in] image               The image
+ * @param[in] iterations          The number of lookups of each call site
+ * @return Nothing
+ */
+void BenchmarkCallSites(const image_t* image, uint32_t iterations)
+{
+    uint32_t* sites = NULL;
+    uint16_t* entries = NULL;
+    uint32_t count = 0;
+    volatile uint32_t sink = 0;
+    struct timespec start = {0};
+    double seconds = 0;
+
+    if (image->unwind_calls_end == image->unwind_calls_start)
+    {
+        return;
+    }
+
+    count = EnumerateCallSites(image, &sites, &entries);
+
+    for (uint32_t hashed = 0; hashed < 2; hashed++)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        for (uint32_t iteration = 0; iteration < iterations; iteration++)
+        {
+            for (uint32_t site = 0; site < count; site++)
+            {
+                sink += hashed ? FindCallSite(sites[site]) : FindExidxEntry(sites[site] - 1).decoded_fn;
+            }
+        }
+
+        seconds = GetSeconds(&start);
+
+        printf("%-13s : %u lookups x %u iterations in %.3f s : %.0f lookups/s\n",
+            hashed ? "Call sites" : "Return lookup", count, iterations, seconds,
+            seconds > 0 ? count * (double) iterations / seconds : 0.0);
+    }
+
+    free(sites);
+    free(entries);
+}
+
+/**
+ * @brief This function reports the memory and the number of probes per lookup of the index,
+ * against a binary search over the whole unwind table.
+ * @param[in] image               The image
+ * @param[in] index               The index
+ * @return Nothing
+ */
+void ReportIndex(const image_t* image, const unwindIndex_t* index)
+{
+    uint32_t entries_count = (image->exidx_end - image->exidx_start) / 8;
+    uint32_t probes = 0;
+    uint32_t max_probes = 0;
+    uint32_t max_entries = 0;
+
+    printf("Binary search : %u entries (%u bytes), %u probes per lookup\n",
+        entries_count, 8 * entries_count, Log2Ceil(entries_count));
+
+    // Every lookup walks down the whole tree, then reads the entry of the node found
+    if (index->header.layout == UNWIND_INDEX_EYTZINGER)
+    {
+        printf("Eytzinger     : %u functions (%u bytes), %u probes per lookup, without branch on the comparisons\n",
+            index->header.count, GetIndexSize(index), Log2Ceil(index->header.count + 1));
+        return;
+    }
+
+    // Only the ranges are searched, the pool is read once per lookup
+    if (index->header.layout == UNWIND_INDEX_POOL)
+    {
+        printf("Program pool  : %u ranges sharing %u programs (%u bytes), %u probes per lookup\n",
+            index->header.count, index->header.pool_count, GetIndexSize(index), Log2Ceil(index->header.count));
+        return;
+    }
+
+    for (uint32_t page = 0; page < index->header.count; page++)
+    {
+        uint32_t entries = index->entries[page + 1] - index->entries[page] + 1;
+
+        probes += Log2Ceil(entries);
+        max_probes = Log2Ceil(entries) > max_probes ? Log2Ceil(entries) : max_probes;
+        max_entries = entries > max_entries ? entries : max_entries;
+    }
+
+    printf("Page index    : %u pages of %u bytes (%u bytes), %.2f probes per lookup (%u at most, %u entries per page at most)\n",
+        index->header.count, 1u << index->header.page_shift, GetIndexSize(index),
+        (double) probes / index->header.count, max_probes, max_entries);
+}
+
+/**
+ * @brief This function times FindExidxEntry on the start of every function, with the
+ * linked index and with a binary search over the whole table.
+ * @param[in] image               The image
+ * @param[in] iterations          The number of lookups of each function
+ * @return Nothing
+ */
+void Benchmark(const image_t* image, uint32_t iterations)
+{
+    uint32_t entries_count = (image->exidx_end - image->exidx_start) / 8;
+    uint32_t layout = 0;
+    volatile uint32_t sink = 0;
+    struct timespec start = {0};
+    double seconds = 0;
+
+    if (image->unwind_index_end - image->unwind_index_start >= sizeof(unwindIndexHeader_t))
+    {
+        layout = HostReadWord(image->unwind_index_start + offsetof(unwindIndexHeader_t, layout));
+    }
+
+    for (uint32_t indexed = 0; indexed < 2; indexed++)
+    {
+        // Without index, the unwinder sees an empty `.unwind_index` section
+        host_unwind_index_end = indexed ? image->unwind_index_end : image->unwind_index_start;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        for (uint32_t iteration = 0; iteration < iterations; iteration++)
+        {
+            for (uint32_t index = 0; index < entries_count; index++)
+            {
+                sink += FindExidxEntry(GetExidxEntry(image->exidx_start, 8 * index).decoded_fn + 2).decoded_fn;
+            }
+        }
+
+        seconds = GetSeconds(&start);
+
+        printf("%-13s : %u lookups x %u iterations in %.3f s : %.0f lookups/s\n",
+            !indexed ? "Binary search"
+                : layout == UNWIND_INDEX_EYTZINGER ? "Eytzinger"
+                : layout == UNWIND_INDEX_POOL ? "Program pool" : "Page index",
+            entries_count, iterations, seconds,
+            seconds > 0 ? entries_count * (double) iterations / seconds : 0.0);
+
+        if (layout == 0)
+        {
+            break;
+        }
+    }
+
+    host_unwind_index_end = image->unwind_index_end;
+}
+
+/**
+ * @brief This function compares the lookup latency of a binary search over a sorted table
+ * with an Eytzinger search (SearchEytzinger, with prefetch) over tables of 1k to 1M random
+ * functions. The tables of the largest sizes do not fit in the host caches anymore.
+ * @param[in] lookups             The number of random lookups per table
+ * @return Nothing
+ */
+void CompareLayouts(uint32_t lookups)
+{
+    uint32_t* sorted = calloc(LAYOUTS_MAX_SIZE, sizeof(uint32_t));
+    uint32_t* keys = calloc(LAYOUTS_MAX_SIZE + 1, sizeof(uint32_t));
+    uint32_t* order = calloc(LAYOUTS_MAX_SIZE + 1, sizeof(uint32_t));
+    uint32_t* queries = calloc(lookups, sizeof(uint32_t));
+    uint32_t random = 0x12345678;
+    uint32_t checksums[2] = {0};
+    double seconds[2] = {0};
+    struct timespec start = {0};
+
+    if (sorted == NULL || keys == NULL || order == NULL || queries == NULL)
+    {
+        fprintf(stderr, "Can not allocate the tables\n");
+        lookups = 0;
+    }
+
+    printf("%10s  %14s  %14s\n", "Functions", "Binary (ns)", "Eytzinger (ns)");
+
+    for (uint32_t count = LAYOUTS_MIN_SIZE; lookups > 0 && count <= LAYOUTS_MAX_SIZE; count *= 10)
+    {
+        // Functions of 4 to 256 bytes, looked up at random addresses (xorshift)
+        for (uint32_t function = 0; function < count; function++)
+        {
+            random ^= random << 13;
+            random ^= random >> 17;
+            random ^= random << 5;
+            sorted[function] = (function == 0 ? 0x1000 : sorted[function - 1]) + 4 * (1 + random % 64);
+        }
+
+        for (uint32_t query = 0; query < lookups; query++)
+        {
+            random ^= random << 13;
+            random ^= random >> 17;
+            random ^= random << 5;
+            queries[query] = sorted[0] + random % (sorted[count - 1] - sorted[0] + 256);
+        }
+
+        BuildEytzinger(sorted, count, keys, order, 0, 1);
+
+        // Number of functions starting at or below the address, with a binary search
+        checksums[0] = 0;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        for (uint32_t query = 0; query < lookups; query++)
+        {
+            uint32_t low = 0;
+            uint32_t high = count;
+
+            while (low < high)
+            {
+                uint32_t middle = low + (high - low) / 2;
+
+                if (sorted[middle] <= queries[query])
+                {
+                    low = middle + 1;
+                }
+                else
+                {
+                    high = middle;
+                }
+            }
+
+            checksums[0] += low;
+        }
+
+        seconds[0] = GetSeconds(&start);
+
+        // Same count, with the Eytzinger search
+        checksums[1] = 0;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        for (uint32_t query = 0; query < lookups; query++)
+        {
+            uint32_t node = SearchEytzinger(keys, count, queries[query]);
+
+            checksums[1] += node == 0 ? count : order[node];
+        }
+
+        seconds[1] = GetSeconds(&start);
+
+        printf("%10u  %14.1f  %14.1f%s\n", count, 1e9 * seconds[0] / lookups, 1e9 * seconds[1] / lookups,
+            checksums[0] == checksums[1] ? "" : "  (results differ)");
+    }
+
+    free(sorted);
+    free(keys);
+    free(order);
+    free(queries);
+}
+
+/**
+ * @brief This function computes the size of an index as linked on target.
+ * @param[in] index               The index
+ * @return The size in bytes, including the header
+ */
+uint32_t GetIndexSize(const unwindIndex_t* index)
+{
+    uint32_t size = sizeof(unwindIndexHeader_t) + 2 * GetIndexLength(index) + 4 * index->header.pool_count;
+
+    if (index->keys != NULL)
+    {
+        size += 4 * GetIndexLength(index);
+    }
+
+    return size;
+}
+
+/**
+ * @brief This function computes the number of keys and entries of an index.
+ * @param[in] index               The index
+ * @return `count + 1` (pages, eytzinger) or `count` (pool)
+ */
+uint32_t GetIndexLength(const unwindIndex_t* index)
+{
+    return index->header.layout == UNWIND_INDEX_POOL ? index->header.count : index->header.count + 1;
+}
+
+/**
+ * @brief This function computes the number of probes of a binary search.
+ * @param[in] value               The number of searched entries
+ * @return The smallest n such as 2^n >= value
+ */
+uint32_t Log2Ceil(uint32_t value)
+{
+    uint32_t log = 0;
+
+    while ((1u << log) < value)
+    {
+        log++;
+    }
+
+    return log;
+}
+
+/**
+ * @brief This function measures the time elapsed since a start time.
+ * @param[in] start               The start time (CLOCK_MONOTONIC)
+ * @return The elapsed time in seconds
+ */
+double GetSeconds(const struct timespec* start)
+{
+    struct timespec end = {0};
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+ * @brief This function releases an index built on host.
+ * @param[in,out] index           The index
+ * @return Nothing
+ */
+void FreeIndex(unwindIndex_t* index)
+{
+    free(index->keys);
+    free(index->pool);
+    free(index->entries);
+    memset(index, 0, sizeof(*index));
+}
+
+/**
+ * @brief This function releases a call sites table built on host.
+ * @param[in,out] calls           The table
+ * @return Nothing
+ */
+void FreeCallSites(callSites_t* calls)
+{
+    free(calls->keys);
+    free(calls->displacements);
+    free(calls->entries);
+    memset(calls, 0, sizeof(*calls));
+}
+
+/**
+ * @brief This function reads a target halfword.
+ * @param[in] address             The target address (halfword aligned)
+ * @return The halfword, or 0 if the address is not in the image
+ */
+uint32_t ReadHalfword(uint32_t address)
+{
+    return (HostReadWord(address & ~0x3u) >> ((address & 0x2) * 8)) & 0xffff;
+}
+
+/**
+ * @brief This function orders addresses (qsort).
+ */
+int CompareAddresses(const void* a, const void* b)
+{
+    uint32_t first = *(const uint32_t *) a;
+    uint32_t second = *(const uint32_t *) b;
+
+    return (first > second) - (first < second);
+}